@@ -11,6 +11,8 @@
 #include <unordered_set>
 // Inclusión de mapas ordenados (Árboles Rojo-Negro generalmente)
 #include <map>
+// Inclusión de conjuntos ordenados (índice de títulos por (título, ISBN))
+#include <set>
 // Inclusión de algoritmos estándar (sort, transform, etc.)
 #include <algorithm>
 // Inclusión de colas (FIFO)
@@ -23,6 +25,41 @@
 #include <cctype>
 // Inclusión de herramientas para generación de números aleatorios
 #include <random>
+// Inclusión de relojes para medir el tiempo entre volcados a disco
+#include <chrono>
+// Inclusión de la fecha del calendario (fecha de cierre de los préstamos)
+#include <ctime>
+// Inclusión de enteros de ancho fijo para el formato binario
+#include <cstdint>
+// Inclusión de memcpy/memcmp para leer registros binarios
+#include <cstring>
+// Inclusión de utilidades de sistema de archivos (directorios, renombrado)
+#include <filesystem>
+// Inclusión de vistas de texto sin copia
+#include <string_view>
+// Inclusión de conversión numérica sin excepciones (from_chars)
+#include <charconv>
+// Inclusión de hilos y contadores atómicos para la carga en paralelo
+#include <thread>
+#include <atomic>
+// Inclusión de std::function para las listas de tareas
+#include <functional>
+// Inclusión de candados, variables de condición y deque para el hilo escritor
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#ifndef _WIN32
+// Inclusión de llamadas POSIX para proyectar archivos en memoria (open, mmap)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+// Intrínsecos SSE2/AVX2 para el escaneo vectorial del CSV (solo x86-64 con GCC/Clang)
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BIBLIOTECA_SIMD_X86 1
+#include <immintrin.h>
+#endif
 
 // Uso del espacio de nombres estándar para evitar escribir std::
 using namespace std;
@@ -67,52 +104,463 @@ string trim(const string& str) {
 }
 
 // ------------------ Trie -----------------
-// Estructura de datos Trie (Árbol de prefijos) para búsquedas de texto
+// Estructura de datos Trie (Árbol de prefijos) para búsquedas de texto, con los caminos sin
+// ramificaciones comprimidos en una sola arista (trie radix): un título entero que no comparte
+// prefijo con otro ocupa un nodo, no uno por carácter.
+// Cada palabra tiene un puntaje y cada nodo con hijos guarda las K_MEJORES palabras de mayor
+// puntaje de su subárbol, así que sugerir K palabras para un prefijo cuesta O(prefijo + K) sin
+// recorrer el subárbol. Esas listas se rehacen de abajo hacia arriba por el camino de cada
+// palabra que se inserta, se quita o cambia de puntaje.
 struct Trie {
-    // Definición del nodo del Trie
+    // Cantidad de mejores palabras que guarda cada nodo
+    static constexpr size_t K_MEJORES = 10;
+
+    // Definición del nodo del Trie (24 bytes; la mayoría son hojas sin hijos)
     struct Nodo {
-        // Mapa para guardar los hijos del nodo (carácter -> índice en vector)
-        unordered_map<char, int> siguiente;
+        // Etiqueta de la arista que llega al nodo: posición y largo dentro de 'etiquetas'
+        uint32_t inicio = 0;
+        uint32_t largo = 0;
+        // Posición de sus hijos en 'ramas' (-1 si no tiene)
+        int ramas = -1;
+        // Nodo padre (-1 en la raíz), para reconstruir la palabra de un nodo
+        int padre = -1;
+        // Puntaje de la palabra que termina aquí
+        int puntaje = 0;
         // Bandera para indicar si este nodo marca el final de una palabra
         bool fin = false;
     };
+    // Una palabra candidata: su puntaje y el nodo donde termina
+    struct Candidato {
+        int puntaje;
+        int nodo;
+    };
+    // Hijos de un nodo: el primer carácter de la etiqueta de cada uno, ordenados (hasta 15
+    // caben sin memoria aparte), y el índice del hijo en la misma posición. 'mejores' tiene las
+    // palabras de mayor puntaje del subárbol (empates en orden alfabético)
+    struct Ramas {
+        string primeros;
+        vector<int> hijos;
+        vector<Candidato> mejores;
+    };
     // Vector que almacena todos los nodos del Trie (implementación dinámica)
     // Se inicializa con un nodo raíz vacío
     vector<Nodo> tabla = { Nodo() };
+    vector<Ramas> ramas;
+    // Falso mientras se carga en bloque: las listas de mejores se arman todas juntas con
+    // recalcular_todo() y desde ahí se mantienen en cada cambio
+    bool con_mejores = false;
+    // Texto de todas las etiquetas. Al partir una arista las dos mitades siguen apuntando al
+    // mismo texto; el de los nodos que se borran queda sin usar hasta compactar_etiquetas()
+    string etiquetas;
+    size_t etiquetas_sin_usar = 0;
+    // Posiciones de 'tabla' y de 'ramas' liberadas al quitar palabras (se reutilizan)
+    vector<int> nodos_libres;
+    vector<int> ramas_libres;
+
+    // Etiqueta de la arista que llega al nodo 'u'
+    string_view etiqueta(int u) const {
+        return string_view(etiquetas).substr(tabla[u].inicio, tabla[u].largo);
+    }
+
+    // Hijos del nodo 'u' (vacío si es una hoja)
+    const vector<int>& hijos(int u) const {
+        static const vector<int> ninguno;
+        return tabla[u].ramas < 0 ? ninguno : ramas[tabla[u].ramas].hijos;
+    }
+
+    // Hijo de 'u' cuya etiqueta empieza con 'c' (-1 si no hay). Los primeros caracteres están
+    // juntos: memchr los compara de a muchos a la vez
+    int buscar_hijo(int u, char c) const {
+        if (tabla[u].ramas < 0) {
+            return -1;
+        }
+        const Ramas& r = ramas[tabla[u].ramas];
+        const void* p = memchr(r.primeros.data(), c, r.primeros.size());
+        return p ? r.hijos[static_cast<const char*>(p) - r.primeros.data()] : -1;
+    }
+
+    // Reemplaza el hijo de 'u' que empieza con 'c' por 'v'
+    void reemplazar_hijo(int u, char c, int v) {
+        Ramas& r = ramas[tabla[u].ramas];
+        r.hijos[r.primeros.find(c)] = v;
+    }
+
+    // Guarda el nodo en una posición libre de 'tabla' (o al final) y retorna su índice
+    int nuevo_nodo(const Nodo& nodo) {
+        if (nodos_libres.empty()) {
+            tabla.push_back(nodo);
+            return static_cast<int>(tabla.size()) - 1;
+        }
+        int v = nodos_libres.back();
+        nodos_libres.pop_back();
+        tabla[v] = nodo;
+        return v;
+    }
+
+    // Libera el nodo 'v' (ya desenganchado y sin hijos); su etiqueta queda sin usar
+    void liberar_nodo(int v) {
+        etiquetas_sin_usar += tabla[v].largo;
+        tabla[v] = Nodo();
+        nodos_libres.push_back(v);
+    }
+
+    // Libera la lista de hijos de 'u' (y su lista de mejores)
+    void liberar_ramas(int u) {
+        ramas[tabla[u].ramas] = Ramas();
+        ramas_libres.push_back(tabla[u].ramas);
+        tabla[u].ramas = -1;
+    }
+
+    // Crea un nodo con la etiqueta 'texto' (guardada al final de 'etiquetas') y lo cuelga de 'u'
+    // en su lugar según el orden de los primeros caracteres
+    int agregar_hijo(int u, string_view texto) {
+        Nodo nuevo;
+        nuevo.inicio = static_cast<uint32_t>(etiquetas.size());
+        nuevo.largo = static_cast<uint32_t>(texto.size());
+        nuevo.padre = u;
+        etiquetas.append(texto.data(), texto.size());
+        int v = nuevo_nodo(nuevo);
+        enganchar(u, texto[0], v);
+        return v;
+    }
+
+    // Pone a 'v' como hijo de 'u' bajo el carácter 'c', manteniendo el orden
+    void enganchar(int u, char c, int v) {
+        if (tabla[u].ramas < 0) {
+            if (ramas_libres.empty()) {
+                tabla[u].ramas = static_cast<int>(ramas.size());
+                ramas.emplace_back();
+            }
+            else {
+                tabla[u].ramas = ramas_libres.back();
+                ramas_libres.pop_back();
+            }
+        }
+        Ramas& r = ramas[tabla[u].ramas];
+        size_t pos = lower_bound(r.primeros.begin(), r.primeros.end(), c,
+            [](char a, char b) { return static_cast<unsigned char>(a) < static_cast<unsigned char>(b); }) - r.primeros.begin();
+        r.primeros.insert(r.primeros.begin() + pos, c);
+        r.hijos.insert(r.hijos.begin() + pos, v);
+    }
 
-    // Función para insertar una palabra en el Trie
-    void insertar(const string& s) {
+    // Función para insertar una palabra en el Trie con su puntaje (si ya estaba, solo cambia
+    // el puntaje)
+    void insertar(const string& s, int puntaje = 0) {
         // Índice del nodo actual, comienza en la raíz (0)
         int u = 0;
-        // Recorre cada carácter de la cadena
-        for (char c : s) {
-            // Si el carácter no existe en los hijos del nodo actual
-            if (!tabla[u].siguiente.count(c)) {
-                // Asigna el índice del nuevo nodo (tamaño actual del vector)
-                tabla[u].siguiente[c] = (int)tabla.size();
-                // Añade un nuevo nodo vacío al vector
-                tabla.push_back(Nodo());
+        // Posición del primer carácter todavía no consumido
+        size_t i = 0;
+        while (i < s.size()) {
+            int v = buscar_hijo(u, s[i]);
+            // Ningún hijo empieza con ese carácter: el resto de la palabra es una arista nueva
+            if (v < 0) {
+                u = agregar_hijo(u, string_view(s).substr(i));
+                break;
             }
-            // Avanza al siguiente nodo
-            u = tabla[u].siguiente[c];
+            // Cuántos caracteres de la etiqueta coinciden con la palabra
+            string_view et = etiqueta(v);
+            size_t k = 0;
+            while (k < et.size() && i + k < s.size() && et[k] == s[i + k]) {
+                k++;
+            }
+            i += k;
+            // La etiqueta coincide entera: se baja al hijo
+            if (k == et.size()) {
+                u = v;
+                continue;
+            }
+            // Coincide en parte: la arista se parte en un nodo intermedio con los k primeros caracteres
+            Nodo medio;
+            medio.inicio = tabla[v].inicio;
+            medio.largo = static_cast<uint32_t>(k);
+            medio.padre = u;
+            int m = nuevo_nodo(medio);
+            tabla[v].inicio += static_cast<uint32_t>(k);
+            tabla[v].largo -= static_cast<uint32_t>(k);
+            tabla[v].padre = m;
+            enganchar(m, et[k], v);
+            reemplazar_hijo(u, et[0], m);
+            u = m;
+            // El nodo intermedio todavía no tiene su lista de mejores
+            recalcular(m);
+            // Lo que queda de la palabra cuelga del nodo intermedio
+            if (i < s.size()) {
+                u = agregar_hijo(m, string_view(s).substr(i));
+            }
+            break;
         }
-        // Marca el nodo final como fin de palabra
+        // Marca el nodo final como fin de palabra, con su puntaje
         tabla[u].fin = true;
+        tabla[u].puntaje = puntaje;
+        recalcular_camino(u);
+    }
+
+    // Nodo donde termina exactamente la palabra 's' (-1 si no está en el Trie)
+    int buscar_palabra(const string& s) const {
+        int u = 0;
+        size_t i = 0;
+        while (i < s.size()) {
+            u = buscar_hijo(u, s[i]);
+            if (u < 0) {
+                return -1;
+            }
+            string_view et = etiqueta(u);
+            if (string_view(s).substr(i, et.size()) != et) {
+                return -1;
+            }
+            i += et.size();
+        }
+        return tabla[u].fin ? u : -1;
+    }
+
+    // Quita la palabra 's' y poda el árbol: se borran los nodos que quedan sin hijos y sin
+    // palabra, y un nodo sin palabra que queda con un solo hijo se funde con él en una arista
+    void quitar(const string& s) {
+        int u = buscar_palabra(s);
+        if (u < 0) {
+            return;
+        }
+        tabla[u].fin = false;
+        tabla[u].puntaje = 0;
+        // 1. Sube borrando hojas que ya no son palabra (la raíz nunca se borra)
+        while (u != 0 && !tabla[u].fin && tabla[u].ramas < 0) {
+            int p = tabla[u].padre;
+            desenganchar(p, u);
+            liberar_nodo(u);
+            u = p;
+        }
+        // 2. El primer nodo que queda perdió un hijo: si ya no ramifica, se funde con el otro
+        if (u != 0 && !tabla[u].fin && hijos(u).size() == 1) {
+            int h = hijos(u)[0];
+            fundir_con_hijo(u);
+            u = h;
+        }
+        // 3. Las listas de mejores del camino que queda ya no tienen la palabra
+        recalcular_camino(u);
+        // Si más de la mitad del texto de las etiquetas quedó sin usar, se rearma
+        if (etiquetas_sin_usar > etiquetas.size() / 2) {
+            compactar_etiquetas();
+        }
+    }
+
+    // Quita al hijo 'v' de la lista de hijos de 'u' (y la lista, si queda vacía)
+    void desenganchar(int u, int v) {
+        Ramas& r = ramas[tabla[u].ramas];
+        size_t pos = r.primeros.find(etiquetas[tabla[v].inicio]);
+        r.primeros.erase(pos, 1);
+        r.hijos.erase(r.hijos.begin() + pos);
+        if (r.hijos.empty()) {
+            liberar_ramas(u);
+        }
+    }
+
+    // Junta al nodo 'u' (sin palabra y con un solo hijo) con su hijo: el hijo toma el lugar de
+    // 'u' con la etiqueta de los dos, y 'u' se libera
+    void fundir_con_hijo(int u) {
+        int h = hijos(u)[0];
+        int p = tabla[u].padre;
+        if (tabla[u].inicio + tabla[u].largo == tabla[h].inicio) {
+            // Las dos etiquetas están seguidas (una arista que se había partido): se reusa el texto
+            tabla[h].inicio = tabla[u].inicio;
+            tabla[h].largo += tabla[u].largo;
+        }
+        else {
+            // Se arma la etiqueta unida antes de añadirla (las vistas apuntan a 'etiquetas')
+            string unida = string(etiqueta(u)) + string(etiqueta(h));
+            etiquetas_sin_usar += tabla[u].largo + tabla[h].largo;
+            tabla[h].inicio = static_cast<uint32_t>(etiquetas.size());
+            tabla[h].largo = static_cast<uint32_t>(unida.size());
+            etiquetas += unida;
+        }
+        tabla[u].largo = 0;
+        tabla[h].padre = p;
+        // La etiqueta de 'h' empieza ahora con el mismo carácter que la de 'u'
+        reemplazar_hijo(p, etiquetas[tabla[h].inicio], h);
+        liberar_ramas(u);
+        liberar_nodo(u);
+    }
+
+    // Rearma 'etiquetas' con solo el texto de los nodos que siguen en el árbol
+    void compactar_etiquetas() {
+        string nuevo;
+        nuevo.reserve(etiquetas.size() - etiquetas_sin_usar);
+        vector<int> pila = { 0 };
+        while (!pila.empty()) {
+            int u = pila.back();
+            pila.pop_back();
+            string_view et = etiqueta(u);
+            tabla[u].inicio = static_cast<uint32_t>(nuevo.size());
+            nuevo.append(et.data(), et.size());
+            for (int v : hijos(u)) {
+                pila.push_back(v);
+            }
+        }
+        etiquetas = std::move(nuevo);
+        etiquetas_sin_usar = 0;
+    }
+
+    // Palabra completa que termina en el nodo 'u' (se arma subiendo por los padres)
+    string palabra(int u) const {
+        vector<int> camino;
+        for (; u > 0; u = tabla[u].padre) {
+            camino.push_back(u);
+        }
+        string texto;
+        for (auto it = camino.rbegin(); it != camino.rend(); ++it) {
+            string_view et = etiqueta(*it);
+            texto.append(et.data(), et.size());
+        }
+        return texto;
+    }
+
+    // Agrega a 'candidatos' las mejores palabras del subárbol de 'v'
+    void agregar_mejores_de(int v, vector<Candidato>& candidatos) const {
+        if (tabla[v].ramas >= 0) {
+            const vector<Candidato>& m = ramas[tabla[v].ramas].mejores;
+            candidatos.insert(candidatos.end(), m.begin(), m.end());
+        }
+        else if (tabla[v].fin) {
+            candidatos.push_back({ tabla[v].puntaje, v });
+        }
+    }
+
+    // Rehace la lista de mejores de 'u' a partir de su propia palabra y las listas de sus hijos.
+    // Los hijos están en orden alfabético y el orden estable conserva ese orden entre empates
+    void recalcular(int u) {
+        if (!con_mejores || tabla[u].ramas < 0) {
+            return;
+        }
+        vector<Candidato> candidatos;
+        if (tabla[u].fin) {
+            candidatos.push_back({ tabla[u].puntaje, u });
+        }
+        for (int v : ramas[tabla[u].ramas].hijos) {
+            agregar_mejores_de(v, candidatos);
+        }
+        stable_sort(candidatos.begin(), candidatos.end(),
+            [](const Candidato& a, const Candidato& b) { return a.puntaje > b.puntaje; });
+        if (candidatos.size() > K_MEJORES) {
+            candidatos.resize(K_MEJORES);
+        }
+        ramas[tabla[u].ramas].mejores = std::move(candidatos);
+    }
+
+    // Rehace las listas de mejores desde 'u' hasta la raíz
+    void recalcular_camino(int u) {
+        for (; u >= 0; u = tabla[u].padre) {
+            recalcular(u);
+        }
+    }
+
+    // Arma todas las listas de mejores (después de una carga en bloque) y las deja activas
+    void recalcular_todo() {
+        con_mejores = true;
+        // Un nodo intermedio de una arista partida tiene índice mayor que sus hijos: se recorre
+        // en orden posterior con una pila explícita en vez de por índice
+        vector<pair<int, bool>> pila = { { 0, false } };
+        while (!pila.empty()) {
+            auto [u, listo] = pila.back();
+            pila.pop_back();
+            if (listo) {
+                recalcular(u);
+                continue;
+            }
+            pila.push_back({ u, true });
+            for (int v : hijos(u)) {
+                pila.push_back({ v, false });
+            }
+        }
+    }
+
+    // Las 'k' palabras de mayor puntaje que empiezan con 'prefijo' (a lo sumo K_MEJORES), de
+    // mayor a menor puntaje y en orden alfabético entre empates
+    vector<string> mejoresPrefijo(const string& prefijo, size_t k) const {
+        vector<string> resultados;
+        int u = nodo_de_prefijo(prefijo);
+        if (u < 0) {
+            return resultados;
+        }
+        vector<Candidato> candidatos;
+        agregar_mejores_de(u, candidatos);
+        for (size_t i = 0; i < candidatos.size() && i < k; ++i) {
+            resultados.push_back(palabra(candidatos[i].nodo));
+        }
+        return resultados;
+    }
+
+    // Nodo donde termina (o dentro de cuya arista termina) el prefijo (-1 si ninguna palabra
+    // empieza así). Si se pasa 'camino', le agrega la palabra del nodo (que puede pasarse del
+    // prefijo a mitad de una arista)
+    int nodo_de_prefijo(const string& prefijo, string* camino = nullptr) const {
+        int u = 0;
+        size_t i = 0;
+        while (i < prefijo.size()) {
+            u = buscar_hijo(u, prefijo[i]);
+            if (u < 0) {
+                return -1;
+            }
+            // La etiqueta debe coincidir con el prefijo hasta donde alcancen ambos
+            string_view et = etiqueta(u);
+            size_t k = min(et.size(), prefijo.size() - i);
+            if (et.compare(0, k, string_view(prefijo).substr(i, k)) != 0) {
+                return -1;
+            }
+            if (camino) {
+                camino->append(et.data(), et.size());
+            }
+            i += k;
+        }
+        return u;
     }
 
-    // --- Función auxiliar recursiva para recolectar palabras ---
-    // Recorre el trie desde un nodo dado para encontrar todas las palabras completas
-    void recolectar(int u, string prefijo_actual, vector<string>& resultados) const {
-        // Si el nodo actual marca el fin de una palabra
+    // --- Recorrido de las palabras de un prefijo ---
+    // Llama a f(palabra) con cada palabra que empieza con 'prefijo', en orden alfabético, hasta
+    // 'limite' palabras o hasta que f devuelva false. Es iterativo: una pila explícita de nodos
+    // pendientes y un solo buffer con la palabra actual, que se recorta y se extiende en cada
+    // arista en vez de armar una cadena nueva por nodo. Devuelve cuántas palabras visitó
+    template <typename F>
+    size_t recorrerPrefijo(const string& prefijo, size_t limite, F&& f) const {
+        // Palabra actual (empieza con el camino hasta el nodo del prefijo)
+        string clave;
+        int u = nodo_de_prefijo(prefijo, &clave);
+        if (u < 0 || limite == 0) {
+            return 0;
+        }
+        size_t visitadas = 0;
+        // El nodo del prefijo ya tiene su etiqueta en 'clave'
         if (tabla[u].fin) {
-            // Añade la palabra formada hasta ahora a los resultados
-            resultados.push_back(prefijo_actual);
+            visitadas++;
+            if (!f(static_cast<const string&>(clave)) || visitadas >= limite) {
+                return visitadas;
+            }
         }
-        // Itera sobre todos los hijos del nodo actual
-        for (auto const& [key, next_node_index] : tabla[u].siguiente) {
-            // Llamada recursiva avanzando al siguiente nodo y añadiendo el carácter al prefijo
-            recolectar(next_node_index, prefijo_actual + key, resultados);
+        // Nodos pendientes y el largo de 'clave' en su padre. Los hijos se apilan al revés para
+        // salir en orden alfabético
+        vector<pair<int, size_t>> pila;
+        pila.reserve(64);
+        const vector<int>& primeros = hijos(u);
+        for (auto it = primeros.rbegin(); it != primeros.rend(); ++it) {
+            pila.push_back({ *it, clave.size() });
         }
+        while (!pila.empty()) {
+            auto [v, largo] = pila.back();
+            pila.pop_back();
+            // Vuelve la palabra al padre de 'v' y le agrega la etiqueta de 'v'
+            string_view et = etiqueta(v);
+            clave.resize(largo);
+            clave.append(et.data(), et.size());
+            if (tabla[v].fin) {
+                visitadas++;
+                if (!f(static_cast<const string&>(clave)) || visitadas >= limite) {
+                    return visitadas;
+                }
+            }
+            const vector<int>& siguientes = hijos(v);
+            for (auto it = siguientes.rbegin(); it != siguientes.rend(); ++it) {
+                pila.push_back({ *it, clave.size() });
+            }
+        }
+        return visitadas;
     }
 
     // --- Función principal de búsqueda ---
@@ -120,23 +568,26 @@ struct Trie {
     vector<string> buscarPrefijo(const string& prefijo) const {
         // Vector para almacenar los resultados
         vector<string> resultados;
-        // Índice del nodo actual, comienza en raíz
-        int u = 0;
-        // 1. Navegar hasta el final del prefijo proporcionado
-        for (char c : prefijo) {
-            // Si en algún punto el camino no existe
-            if (!tabla[u].siguiente.count(c)) {
-                // Retorna la lista vacía porque el prefijo no está en el Trie
-                return resultados; 
-            }
-            // Avanza al siguiente nodo según el carácter
-            u = tabla[u].siguiente.at(c);
-        }
-        // 2. Desde el nodo donde termina el prefijo, recolectar todas las terminaciones posibles
-        recolectar(u, prefijo, resultados);
+        // Recorre todas las terminaciones posibles del prefijo, sin límite
+        recorrerPrefijo(prefijo, SIZE_MAX, [&](const string& palabra) {
+            resultados.push_back(palabra);
+            return true;
+        });
         // Retorna las palabras encontradas
         return resultados;
     }
+
+    // Memoria aproximada del índice (nodos, listas de hijos y etiquetas)
+    size_t bytes() const {
+        size_t total = tabla.capacity() * sizeof(Nodo) + ramas.capacity() * sizeof(Ramas) + etiquetas.capacity();
+        for (const Ramas& r : ramas) {
+            total += r.hijos.capacity() * sizeof(int) + r.mejores.capacity() * sizeof(Candidato);
+            if (r.primeros.capacity() > 15) {
+                total += r.primeros.capacity() + 1;
+            }
+        }
+        return total;
+    }
 };
 
 // ------------------ AVL -----------------
@@ -150,15 +601,49 @@ struct AVL {
         string isbn_str;
         // Altura del nodo para el balanceo
         int altura;
+        // Cantidad de nodos del subárbol (para rango y selección por posición)
+        size_t tamano;
         // Puntero al hijo izquierdo
         N* izquierda;
         // Puntero al hijo derecho
         N* derecha;
         // Constructor del nodo
-        N(long long k, const string& s) : clave(k), isbn_str(s), altura(1), izquierda(nullptr), derecha(nullptr) {}
+        N(long long k, const string& s) : clave(k), isbn_str(s), altura(1), tamano(1), izquierda(nullptr), derecha(nullptr) {}
     };
     // Puntero a la raíz del árbol, inicializado en null
     N* raiz = nullptr;
+    // Almacén de nodos: el deque no mueve los nodos al crecer y libera todos al destruir el
+    // árbol. Los nodos borrados quedan en 'libres' y se reutilizan en las siguientes inserciones
+    deque<N> nodos;
+    vector<N*> libres;
+
+    AVL() = default;
+    // Los punteros apuntan al almacén propio: el árbol no se copia
+    AVL(const AVL&) = delete;
+    AVL& operator=(const AVL&) = delete;
+
+    // Cantidad de claves en el árbol
+    size_t size() const {
+        return Tamano(raiz);
+    }
+
+    // Toma un nodo del almacén (uno liberado si hay, si no uno nuevo)
+    N* nuevo_nodo(long long k, const string& s) {
+        if (libres.empty()) {
+            nodos.emplace_back(k, s);
+            return &nodos.back();
+        }
+        N* n = libres.back();
+        libres.pop_back();
+        n->clave = k;
+        // Asignar sobre la cadena vieja reutiliza su memoria
+        n->isbn_str = s;
+        n->altura = 1;
+        n->tamano = 1;
+        n->izquierda = nullptr;
+        n->derecha = nullptr;
+        return n;
+    }
 
     // Función estática para recorrido In-Order (Izquierda - Raíz - Derecha)
     static void recorridoInOrder(N* n, vector<pair<long long, string>>& claves) {
@@ -184,18 +669,156 @@ struct AVL {
         return claves;
     }
 
+    // Cursor para recorrer el árbol en orden sin copiarlo: una pila explícita guarda el nodo
+    // actual (arriba) y los ancestros que faltan visitar. Cualquier inserción o borrado lo
+    // invalida; para seguir después de un cambio se retoma con upper_bound(última clave)
+    struct Cursor {
+        vector<const N*> pila;
+
+        // Verdadero mientras apunte a un nodo
+        bool valido() const {
+            return !pila.empty();
+        }
+        // Clave e ISBN del nodo actual
+        long long clave() const {
+            return pila.back()->clave;
+        }
+        const string& isbn() const {
+            return pila.back()->isbn_str;
+        }
+        // Apila 'n' y toda su rama izquierda (el mínimo queda arriba)
+        void bajar_izquierda(const N* n) {
+            while (n) {
+                pila.push_back(n);
+                n = n->izquierda;
+            }
+        }
+        // Pasa a la clave siguiente: el mínimo del subárbol derecho o el ancestro pendiente
+        void avanzar() {
+            const N* n = pila.back();
+            pila.pop_back();
+            bajar_izquierda(n->derecha);
+        }
+    };
+
+    // Cursor en la clave más chica
+    Cursor inicio() const {
+        Cursor c;
+        c.pila.reserve(Altura(raiz));
+        c.bajar_izquierda(raiz);
+        return c;
+    }
+
+    // Cursor en la primera clave >= k ('estricto': la primera > k). Al bajar se apilan solo los
+    // nodos donde se dobló a la izquierda: son justo los que quedan por visitar en orden
+    Cursor buscar_cota(long long k, bool estricto) const {
+        Cursor c;
+        c.pila.reserve(Altura(raiz));
+        const N* n = raiz;
+        while (n) {
+            if (n->clave > k || (!estricto && n->clave == k)) {
+                c.pila.push_back(n);
+                n = n->izquierda;
+            }
+            else {
+                n = n->derecha;
+            }
+        }
+        return c;
+    }
+
+    // Cursor en la primera clave >= k
+    Cursor lower_bound(long long k) const {
+        return buscar_cota(k, false);
+    }
+
+    // Cursor en la primera clave > k
+    Cursor upper_bound(long long k) const {
+        return buscar_cota(k, true);
+    }
+
+    // ISBN guardado con la clave 'k' (nullptr si no está)
+    const string* buscar(long long k) const {
+        const N* n = raiz;
+        while (n && n->clave != k) {
+            n = k < n->clave ? n->izquierda : n->derecha;
+        }
+        return n ? &n->isbn_str : nullptr;
+    }
+
+    // Cursor en la clave número 'i' (0 = la más chica) en O(log n), usando los tamaños de los
+    // subárboles. Apila los nodos donde se dobla a la izquierda, igual que buscar_cota
+    Cursor seleccionar(size_t i) const {
+        Cursor c;
+        c.pila.reserve(Altura(raiz));
+        const N* n = raiz;
+        while (n) {
+            size_t izquierda = Tamano(n->izquierda);
+            if (i < izquierda) {
+                c.pila.push_back(n);
+                n = n->izquierda;
+            }
+            else if (i == izquierda) {
+                c.pila.push_back(n);
+                return c;
+            }
+            else {
+                i -= izquierda + 1;
+                n = n->derecha;
+            }
+        }
+        // Posición fuera del árbol: cursor vacío
+        c.pila.clear();
+        return c;
+    }
+
+    // Cantidad de claves menores que 'k' (la posición que tendría 'k' en el listado)
+    size_t posicion(long long k) const {
+        size_t menores = 0;
+        const N* n = raiz;
+        while (n) {
+            if (n->clave < k) {
+                menores += Tamano(n->izquierda) + 1;
+                n = n->derecha;
+            }
+            else {
+                n = n->izquierda;
+            }
+        }
+        return menores;
+    }
+
+    // Llama a f(clave, isbn) para cada clave de [desde, hasta] en orden; si f retorna false se detiene
+    template <typename F>
+    void recorrer_rango(long long desde, long long hasta, F f) const {
+        for (Cursor c = lower_bound(desde); c.valido() && c.clave() <= hasta; c.avanzar()) {
+            if (!f(c.clave(), c.isbn())) {
+                return;
+            }
+        }
+    }
+
     // Función auxiliar para obtener la altura de un nodo de forma segura
     static int Altura(N* n) {
         // Retorna la altura si el nodo existe, si no, retorna 0
         return n ? n->altura : 0;
     }
     
-    // Función para actualizar la altura de un nodo basado en sus hijos
+    // Función auxiliar para obtener el tamaño de un subárbol de forma segura
+    static size_t Tamano(const N* n) {
+        // Retorna el tamaño si el nodo existe, si no, retorna 0
+        return n ? n->tamano : 0;
+    }
+    
+    // Función para actualizar la altura y el tamaño de un nodo basado en sus hijos
+    // (las rotaciones la llaman para los dos nodos que cambian de hijos)
     static void actualizar(N* n) {
         // Si el nodo existe
         if (n) {
             // La altura es 1 + el máximo de la altura de sus hijos
             n->altura = 1 + max(Altura(n->izquierda), Altura(n->derecha));
+            // El tamaño es 1 + los tamaños de sus hijos
+            n->tamano = 1 + Tamano(n->izquierda) + Tamano(n->derecha);
         }
     }
     
@@ -240,10 +863,10 @@ struct AVL {
     }
     
     // Función recursiva para insertar un nodo en el AVL
-    static N* insercion(N* n, long long k, const string& s) {
-        // Caso base: si llegamos a un puntero nulo, creamos el nuevo nodo
+    N* insercion(N* n, long long k, const string& s) {
+        // Caso base: si llegamos a un puntero nulo, tomamos un nodo del almacén
         if (!n) {
-            return new N(k, s);
+            return nuevo_nodo(k, s);
         }
         // Si la clave a insertar es menor, ir a la izquierda
         if (k < n->clave) {
@@ -292,760 +915,4556 @@ struct AVL {
         // Llama a la función recursiva y actualiza la raíz
         raiz = insercion(raiz, k, s); 
     }
-};
-// ------------------ Modelos de datos -----------------
 
-// Estructura que representa un libro en la biblioteca
-struct Libro {
-    // Identificador único del libro (cadena de texto)
-    string isbn;
-    // Versión numérica del ISBN para ordenamiento eficiente en AVL
-    long long isbn_num = 0;
-    // Título del libro
-    string titulo;
-    // Lista de autores del libro
-    vector<string> autores;
-    // Género literario
-    string genero;
-    // Fecha de publicación en formato YYYY-MM-DD
-    string fecha_publi;
-    // Cantidad total de copias físicas que posee la biblioteca
-    int copias_totales = 0;
-    // Cantidad de copias que están actualmente en estante (no prestadas)
-    int copias_disponibles = 0;
-};
+    // Rebalancea un nodo tras un borrado en alguno de sus subárboles
+    static N* balancear(N* n) {
+        // Actualizar la altura y calcular el factor de balance
+        actualizar(n);
+        int b = factorBalance(n);
+        // Cargado a la izquierda: Izquierda-Izquierda (o sin inclinación) o Izquierda-Derecha
+        if (b > 1) {
+            if (factorBalance(n->izquierda) < 0) {
+                n->izquierda = rotacionIzquierda(n->izquierda);
+            }
+            return rotacionDerecha(n);
+        }
+        // Cargado a la derecha: Derecha-Derecha (o sin inclinación) o Derecha-Izquierda
+        if (b < -1) {
+            if (factorBalance(n->derecha) > 0) {
+                n->derecha = rotacionDerecha(n->derecha);
+            }
+            return rotacionIzquierda(n);
+        }
+        return n;
+    }
 
-// Estructura que representa un usuario de la biblioteca
-struct Usuario {
-    // Identificador único del usuario
-    string id_usuario;
-    // Nombre completo del usuario
-    string nombre;
-    // Correo electrónico de contacto
-    string correo;
-    // Historial de ISBNs de libros que el usuario ha tomado prestados (histórico completo)
-    vector<string> historial_isbn;
-    // Conjunto de ISBNs que el usuario tiene prestados ACTUALMENTE (búsqueda rápida)
-    unordered_set<string> prestamos_activos;
-    // Contador de cuántos libros tiene prestados en este momento
-    int num_prestamos_activos = 0;
-    // Historial de títulos de libros leídos (útil si el libro se borra del sistema después)
-    vector<string> historial_titulos;
-};
+    // Función recursiva para borrar la clave 'k' si su ISBN es 's' (otro ISBN con el mismo
+    // valor numérico no se toca)
+    N* eliminacion(N* n, long long k, const string& s) {
+        // Caso base: la clave no está
+        if (!n) {
+            return n;
+        }
+        if (k < n->clave) {
+            n->izquierda = eliminacion(n->izquierda, k, s);
+        }
+        else if (k > n->clave) {
+            n->derecha = eliminacion(n->derecha, k, s);
+        }
+        else if (n->isbn_str != s) {
+            return n;
+        }
+        // Con a lo sumo un hijo, el hijo ocupa su lugar y el nodo vuelve al almacén
+        else if (!n->izquierda || !n->derecha) {
+            N* hijo = n->izquierda ? n->izquierda : n->derecha;
+            libres.push_back(n);
+            return hijo;
+        }
+        // Con dos hijos, toma los datos del sucesor (el mínimo de la derecha) y borra el sucesor
+        else {
+            N* sucesor = n->derecha;
+            while (sucesor->izquierda) {
+                sucesor = sucesor->izquierda;
+            }
+            n->clave = sucesor->clave;
+            n->isbn_str = sucesor->isbn_str;
+            n->derecha = eliminacion(n->derecha, n->clave, n->isbn_str);
+        }
+        return balancear(n);
+    }
 
-// Estructura que representa un préstamo activo o inactivo
-struct Prestamo {
-    // Identificador único de la transacción de préstamo
-    string id_prestamo;
-    // Título del libro prestado (snapshot al momento del préstamo)
-    string titulo;
-    // ISBN del libro prestado
-    string isbn;
-    // ID del usuario que tiene el libro
-    string id_usuario;
-    // Estado del préstamo: true si el libro aún no se ha devuelto, false si ya se devolvió
-    bool activo = true;
+    // Función pública para borrar del árbol
+    void quitar(long long k, const string& s) {
+        raiz = eliminacion(raiz, k, s);
+    }
 };
 
-// ------------------ Biblioteca -----------------
-// Clase principal que gestiona toda la lógica del sistema
-class Biblioteca {
-private:
-    // --- Persistencia CSV ---
-    // Nombre del archivo para guardar libros
-    const string LIBROS_CSV = "libros.csv";
-    // Nombre del archivo para guardar usuarios
-    const string USUARIOS_CSV = "usuarios.csv";
-    // Nombre del archivo para guardar préstamos
-    const string PRESTAMOS_CSV = "prestamos.csv";
-    // Nombre del archivo para guardar la lista de espera
-    const string LISTA_ESPERA_CSV = "lista_espera.csv";
-    // Delimitador usado en los archivos CSV (coma)
-    static const char DELIMITADOR = ',';
-
-    // Base de datos en memoria: ISBN -> Objeto Libro
-    unordered_map<string, Libro> libros;
-    // Base de datos en memoria: ID Usuario -> Objeto Usuario
-    unordered_map<string, Usuario> usuarios;
-    // Cola de espera: ISBN -> Cola de IDs de usuarios esperando ese libro
-    unordered_map<string, queue<string>> lista_espera;
-    // Índice secundario ordenado: Título -> ISBN (permite listar alfabéticamente)
-    map<string, string> indice;
-    // Estructura Trie para autocompletado y búsqueda por prefijo
-    Trie trie;
-    // Árbol AVL para ordenar libros por ISBN numérico
-    AVL isbn_avl;
-    // Mapa para conectar: Texto de búsqueda (normalizado) -> Lista de ISBNs coincidentes
-    unordered_map<string, vector<string>> mapa_busqueda;
-    // Base de datos en memoria de préstamos: ID Préstamo -> Objeto Préstamo
-    unordered_map<string, Prestamo> prestamos;
-    // Grafo para recomendaciones: ISBN A -> (ISBN B -> Peso de conexión)
-    unordered_map<string, unordered_map<string, int>> grafico_libro;
-    // Mapa auxiliar (parece redundante con Usuario::historial_isbn, pero se mantiene según original)
-    unordered_map<string, unordered_set<string>> libros_usuario;
+// ------------------ Árbol B+ -----------------
+// Alternativa al AVL para el índice por ISBN numérico, con la misma interfaz (insertar,
+// quitar, buscar, recorrer_rango, obtenerClavesOrdenadas). Cada nodo guarda muchas claves
+// contiguas (32 claves de 8 bytes = 4 líneas de caché), así que una búsqueda toca pocos nodos y
+// compara dentro de un arreglo en lugar de saltar de puntero en puntero. Los ISBN en texto van
+// en un bloque aparte por hoja: una búsqueda recorre solo claves y lee el texto al encontrarla. Las hojas están
+// enlazadas en orden para los recorridos. Los nodos viven en almacenes propios con lista de
+// libres, como los del AVL.
+struct ArbolBMas {
+    // Capacidad de los arreglos de un nodo; un nodo puede pasarse en una clave justo antes de dividirse
+    static const int CAPACIDAD = 32;
+    static const int MAX_CLAVES = CAPACIDAD - 1;
+    // Mínimo de claves de un nodo que no es la raíz (si queda por debajo, pide prestado o se fusiona)
+    static const int MIN_CLAVES = MAX_CLAVES / 2;
+    // Índice de nodo nulo
+    static const uint32_t NULO = UINT32_MAX;
 
-    // Enumeración para definir los tipos de acciones que se pueden deshacer
-   enum class TipoAccion { 
-        AgregarLibro,
-        EliminarLibro,
-        ModificarLibro,
-        AgregarUsuario,
-        EliminarUsuario,
-        PrestarLibro,
-        DevolverLibro,
-        PonerenCola
+    // Hoja: claves ordenadas y la hoja siguiente
+    struct Hoja {
+        int n = 0;
+        long long claves[CAPACIDAD];
+        uint32_t siguiente = NULO;
     };
-    
-    // Estructura para registrar una acción en el historial (Pila de deshacer)
-    struct Accion {
-        TipoAccion tipo;
-        string id;      // ID principal afectado (ej. ISBN o ID Usuario)
-        string usuario; // ID secundario afectado (ej. Usuario en préstamo)
-        string datos;   // Datos extra si se requieren para restaurar estado
+    // ISBN de cada clave de una hoja (mismo número y misma posición que en la hoja)
+    struct TextosHoja {
+        string isbns[CAPACIDAD];
+    };
+    // Nodo interno: 'n' separadores y 'n + 1' hijos. Las claves iguales al separador i están
+    // en el hijo i + 1
+    struct Interno {
+        int n = 0;
+        long long claves[CAPACIDAD];
+        uint32_t hijos[CAPACIDAD + 1];
     };
 
-    // Vector que funciona como pila para almacenar el historial de acciones
-    vector<Accion> historial_acciones;
+    // Almacenes de nodos y sus números libres. Son vectores para que pasar de un número a su nodo
+    // sea un solo acceso; como se mueven al crecer, tras pedir un nodo nuevo se vuelven a tomar
+    // las referencias
+    vector<Hoja> hojas;
+    vector<TextosHoja> textos;
+    vector<Interno> internos;
+    vector<uint32_t> hojas_libres, internos_libres;
+    // Raíz y cantidad de niveles (1: la raíz es una hoja)
+    uint32_t raiz;
+    int niveles = 1;
+    size_t cantidad = 0;
 
-    // Función privada para añadir una acción al historial
-    void registrar_accion(const Accion& a) { 
-        // Empuja la acción al final del vector
-        historial_acciones.push_back(a); 
+    ArbolBMas() {
+        raiz = nueva_hoja();
     }
-    
-    // --- Manejo de comillas/comas en CSV ---
-    // Escapa cadenas para formato CSV (si tienen comas o comillas, las envuelve en comillas)
-    static string csv_quote(const string& s) {
-        // Verifica si la cadena necesita ser escapada (contiene delimitador o comillas)
-        if (s.find(DELIMITADOR) == string::npos && s.find('"') == string::npos) {
-            // Si es segura, la retorna tal cual
-            return s;
+    ArbolBMas(const ArbolBMas&) = delete;
+    ArbolBMas& operator=(const ArbolBMas&) = delete;
+
+    // Cantidad de claves en el árbol
+    size_t size() const {
+        return cantidad;
+    }
+
+    // Toma una hoja del almacén
+    uint32_t nueva_hoja() {
+        if (!hojas_libres.empty()) {
+            uint32_t h = hojas_libres.back();
+            hojas_libres.pop_back();
+            hojas[h].n = 0;
+            hojas[h].siguiente = NULO;
+            return h;
         }
-        // Inicia la cadena de salida con una comilla de apertura
-        string out = "\"";
-        // Recorre cada carácter de la cadena original
-        for (char c : s) {
-            // Si encuentra una comilla doble, debe duplicarla para escaparla (regla CSV)
-            if (c == '"') {
-                out += "\"\"";
+        hojas.emplace_back();
+        textos.emplace_back();
+        return static_cast<uint32_t>(hojas.size() - 1);
+    }
+
+    // Toma un nodo interno del almacén
+    uint32_t nuevo_interno() {
+        if (!internos_libres.empty()) {
+            uint32_t i = internos_libres.back();
+            internos_libres.pop_back();
+            internos[i].n = 0;
+            return i;
+        }
+        internos.emplace_back();
+        return static_cast<uint32_t>(internos.size() - 1);
+    }
+
+    // Cantidad de claves de 'claves[0..n)' menores que 'k' ('incluir_iguales': menores o iguales).
+    // Con 32 claves contiguas un conteo sin saltos (que el compilador vectoriza) le gana a la
+    // búsqueda binaria, que falla la predicción de casi todas sus comparaciones
+    static int contar_menores(const long long* claves, int n, long long k, bool incluir_iguales) {
+        int cuenta = 0;
+        if (incluir_iguales) {
+            for (int j = 0; j < n; ++j) {
+                cuenta += claves[j] <= k;
             }
-            else {
-                // Si es un carácter normal, lo añade
-                out.push_back(c);
+        }
+        else {
+            for (int j = 0; j < n; ++j) {
+                cuenta += claves[j] < k;
             }
         }
-        // Cierra la cadena con una comilla
-        out += "\"";
-        // Retorna la cadena formateada
-        return out;
+        return cuenta;
+    }
+
+    // Posición del hijo de 'nodo' donde está (o iría) la clave 'k'
+    static int hijo_para(const Interno& nodo, long long k) {
+        return contar_menores(nodo.claves, nodo.n, k, true);
+    }
+
+    // Posición de la primera clave >= k de la hoja 'h'
+    static int posicion_en_hoja(const Hoja& h, long long k) {
+        return contar_menores(h.claves, h.n, k, false);
+    }
+
+    // Hoja donde está (o iría) la clave 'k'
+    uint32_t hoja_para(long long k) const {
+        uint32_t nodo = raiz;
+        for (int nivel = niveles; nivel > 1; --nivel) {
+            const Interno& in = internos[nodo];
+            nodo = in.hijos[hijo_para(in, k)];
+        }
+        return nodo;
+    }
+
+    // ISBN guardado con la clave 'k' (nullptr si no está)
+    const string* buscar(long long k) const {
+        uint32_t nodo = hoja_para(k);
+        const Hoja& h = hojas[nodo];
+        int i = posicion_en_hoja(h, k);
+        return (i < h.n && h.claves[i] == k) ? &textos[nodo].isbns[i] : nullptr;
+    }
+
+    // Inserta 'k' en el subárbol 'nodo' del nivel 'nivel'. Si el nodo se divide retorna true y
+    // deja en 'separador' y 'derecho' la primera clave y el número de la mitad nueva
+    bool insercion(uint32_t nodo, int nivel, long long k, const string& s, long long& separador, uint32_t& derecho) {
+        if (nivel == 1) {
+            Hoja& h = hojas[nodo];
+            string* isbns = textos[nodo].isbns;
+            int i = posicion_en_hoja(h, k);
+            // Como en el AVL, una clave repetida no se inserta
+            if (i < h.n && h.claves[i] == k) {
+                return false;
+            }
+            for (int j = h.n; j > i; --j) {
+                h.claves[j] = h.claves[j - 1];
+                isbns[j].swap(isbns[j - 1]);
+            }
+            h.claves[i] = k;
+            isbns[i] = s;
+            h.n++;
+            cantidad++;
+            if (h.n <= MAX_CLAVES) {
+                return false;
+            }
+            // Hoja llena: la mitad superior pasa a una hoja nueva enlazada a continuación
+            derecho = nueva_hoja();
+            Hoja& hl = hojas[nodo];
+            Hoja& hr = hojas[derecho];
+            string* isbns_l = textos[nodo].isbns;
+            string* isbns_r = textos[derecho].isbns;
+            int mitad = hl.n / 2;
+            for (int j = mitad; j < hl.n; ++j) {
+                hr.claves[j - mitad] = hl.claves[j];
+                isbns_r[j - mitad].swap(isbns_l[j]);
+            }
+            hr.n = hl.n - mitad;
+            hl.n = mitad;
+            hr.siguiente = hl.siguiente;
+            hl.siguiente = derecho;
+            separador = hr.claves[0];
+            return true;
+        }
+        int i = hijo_para(internos[nodo], k);
+        long long sep_hijo;
+        uint32_t der_hijo;
+        if (!insercion(internos[nodo].hijos[i], nivel - 1, k, s, sep_hijo, der_hijo)) {
+            return false;
+        }
+        // El hijo se dividió: su mitad derecha entra a continuación
+        Interno& in = internos[nodo];
+        for (int j = in.n; j > i; --j) {
+            in.claves[j] = in.claves[j - 1];
+            in.hijos[j + 1] = in.hijos[j];
+        }
+        in.claves[i] = sep_hijo;
+        in.hijos[i + 1] = der_hijo;
+        in.n++;
+        if (in.n <= MAX_CLAVES) {
+            return false;
+        }
+        // Nodo lleno: la clave del medio sube y las de la derecha pasan a un nodo nuevo
+        derecho = nuevo_interno();
+        Interno& il = internos[nodo];
+        Interno& ir = internos[derecho];
+        int mitad = il.n / 2;
+        separador = il.claves[mitad];
+        ir.n = il.n - mitad - 1;
+        for (int j = 0; j < ir.n; ++j) {
+            ir.claves[j] = il.claves[mitad + 1 + j];
+        }
+        for (int j = 0; j <= ir.n; ++j) {
+            ir.hijos[j] = il.hijos[mitad + 1 + j];
+        }
+        il.n = mitad;
+        return true;
+    }
+
+    // Función pública para insertar en el árbol
+    void insertar(long long k, const string& s) {
+        long long separador;
+        uint32_t derecho;
+        if (!insercion(raiz, niveles, k, s, separador, derecho)) {
+            return;
+        }
+        // La raíz se dividió: el árbol crece un nivel
+        uint32_t nueva = nuevo_interno();
+        Interno& in = internos[nueva];
+        in.n = 1;
+        in.claves[0] = separador;
+        in.hijos[0] = raiz;
+        in.hijos[1] = derecho;
+        raiz = nueva;
+        niveles++;
+    }
+
+    // Cantidad de claves del nodo 'nodo' del nivel 'nivel'
+    int claves_de(uint32_t nodo, int nivel) const {
+        return nivel == 1 ? hojas[nodo].n : internos[nodo].n;
+    }
+
+    // Junta el hijo 'i + 1' de 'padre' dentro del hijo 'i' (ambos del nivel 'nivel') y libera el
+    // de la derecha
+    void fusionar(Interno& padre, int i, int nivel) {
+        uint32_t izq = padre.hijos[i], der = padre.hijos[i + 1];
+        if (nivel == 1) {
+            Hoja& hl = hojas[izq];
+            Hoja& hr = hojas[der];
+            string* isbns_l = textos[izq].isbns;
+            string* isbns_r = textos[der].isbns;
+            for (int j = 0; j < hr.n; ++j) {
+                hl.claves[hl.n + j] = hr.claves[j];
+                isbns_l[hl.n + j].swap(isbns_r[j]);
+            }
+            hl.n += hr.n;
+            hl.siguiente = hr.siguiente;
+            hojas_libres.push_back(der);
+        }
+        else {
+            Interno& il = internos[izq];
+            Interno& ir = internos[der];
+            // El separador del padre baja entre las claves de ambos
+            il.claves[il.n] = padre.claves[i];
+            for (int j = 0; j < ir.n; ++j) {
+                il.claves[il.n + 1 + j] = ir.claves[j];
+            }
+            for (int j = 0; j <= ir.n; ++j) {
+                il.hijos[il.n + 1 + j] = ir.hijos[j];
+            }
+            il.n += ir.n + 1;
+            internos_libres.push_back(der);
+        }
+        // El padre pierde el separador i y el hijo i + 1
+        for (int j = i; j + 1 < padre.n; ++j) {
+            padre.claves[j] = padre.claves[j + 1];
+            padre.hijos[j + 1] = padre.hijos[j + 2];
+        }
+        padre.n--;
+    }
+
+    // Pasa una clave del hijo 'i - 1' al hijo 'i' de 'padre' (ambos del nivel 'nivel')
+    void prestar_de_izquierda(Interno& padre, int i, int nivel) {
+        uint32_t izq = padre.hijos[i - 1], hijo = padre.hijos[i];
+        if (nivel == 1) {
+            Hoja& hl = hojas[izq];
+            Hoja& h = hojas[hijo];
+            string* isbns_l = textos[izq].isbns;
+            string* isbns = textos[hijo].isbns;
+            for (int j = h.n; j > 0; --j) {
+                h.claves[j] = h.claves[j - 1];
+                isbns[j].swap(isbns[j - 1]);
+            }
+            h.claves[0] = hl.claves[hl.n - 1];
+            isbns[0].swap(isbns_l[hl.n - 1]);
+            h.n++;
+            hl.n--;
+            padre.claves[i - 1] = h.claves[0];
+        }
+        else {
+            Interno& il = internos[izq];
+            Interno& in = internos[hijo];
+            for (int j = in.n; j > 0; --j) {
+                in.claves[j] = in.claves[j - 1];
+            }
+            for (int j = in.n + 1; j > 0; --j) {
+                in.hijos[j] = in.hijos[j - 1];
+            }
+            // Rota por el padre: su separador baja y la última clave del hermano sube
+            in.claves[0] = padre.claves[i - 1];
+            in.hijos[0] = il.hijos[il.n];
+            in.n++;
+            padre.claves[i - 1] = il.claves[il.n - 1];
+            il.n--;
+        }
+    }
+
+    // Pasa una clave del hijo 'i + 1' al hijo 'i' de 'padre' (ambos del nivel 'nivel')
+    void prestar_de_derecha(Interno& padre, int i, int nivel) {
+        uint32_t hijo = padre.hijos[i], der = padre.hijos[i + 1];
+        if (nivel == 1) {
+            Hoja& h = hojas[hijo];
+            Hoja& hr = hojas[der];
+            string* isbns = textos[hijo].isbns;
+            string* isbns_r = textos[der].isbns;
+            h.claves[h.n] = hr.claves[0];
+            isbns[h.n].swap(isbns_r[0]);
+            h.n++;
+            for (int j = 0; j + 1 < hr.n; ++j) {
+                hr.claves[j] = hr.claves[j + 1];
+                isbns_r[j].swap(isbns_r[j + 1]);
+            }
+            hr.n--;
+            padre.claves[i] = hr.claves[0];
+        }
+        else {
+            Interno& in = internos[hijo];
+            Interno& ir = internos[der];
+            // Rota por el padre: su separador baja y la primera clave del hermano sube
+            in.claves[in.n] = padre.claves[i];
+            in.hijos[in.n + 1] = ir.hijos[0];
+            in.n++;
+            padre.claves[i] = ir.claves[0];
+            for (int j = 0; j + 1 < ir.n; ++j) {
+                ir.claves[j] = ir.claves[j + 1];
+            }
+            for (int j = 0; j < ir.n; ++j) {
+                ir.hijos[j] = ir.hijos[j + 1];
+            }
+            ir.n--;
+        }
+    }
+
+    // Borra 'k' (si su ISBN es 's') del subárbol 'nodo'. Retorna true si el nodo quedó con
+    // menos claves que el mínimo
+    bool eliminacion(uint32_t nodo, int nivel, long long k, const string& s) {
+        if (nivel == 1) {
+            Hoja& h = hojas[nodo];
+            string* isbns = textos[nodo].isbns;
+            int i = posicion_en_hoja(h, k);
+            if (i == h.n || h.claves[i] != k || isbns[i] != s) {
+                return false;
+            }
+            for (int j = i; j + 1 < h.n; ++j) {
+                h.claves[j] = h.claves[j + 1];
+                isbns[j].swap(isbns[j + 1]);
+            }
+            h.n--;
+            cantidad--;
+            return h.n < MIN_CLAVES;
+        }
+        Interno& in = internos[nodo];
+        int i = hijo_para(in, k);
+        if (!eliminacion(in.hijos[i], nivel - 1, k, s)) {
+            return false;
+        }
+        // El hijo quedó corto: pide prestado a un hermano con claves de sobra o se fusiona con uno
+        if (i > 0 && claves_de(in.hijos[i - 1], nivel - 1) > MIN_CLAVES) {
+            prestar_de_izquierda(in, i, nivel - 1);
+        }
+        else if (i < in.n && claves_de(in.hijos[i + 1], nivel - 1) > MIN_CLAVES) {
+            prestar_de_derecha(in, i, nivel - 1);
+        }
+        else if (i > 0) {
+            fusionar(in, i - 1, nivel - 1);
+        }
+        else {
+            fusionar(in, i, nivel - 1);
+        }
+        return in.n < MIN_CLAVES;
+    }
+
+    // Función pública para borrar del árbol ('s' debe coincidir, como en el AVL)
+    void quitar(long long k, const string& s) {
+        eliminacion(raiz, niveles, k, s);
+        // Una raíz interna sin separadores cede su lugar a su único hijo
+        if (niveles > 1 && internos[raiz].n == 0) {
+            internos_libres.push_back(raiz);
+            raiz = internos[raiz].hijos[0];
+            niveles--;
+        }
+    }
+
+    // Llama a f(clave, isbn) para cada clave de [desde, hasta] en orden siguiendo las hojas
+    // enlazadas; si f retorna false se detiene
+    template <typename F>
+    void recorrer_rango(long long desde, long long hasta, F f) const {
+        uint32_t nodo = hoja_para(desde);
+        const Hoja* h = &hojas[nodo];
+        int i = posicion_en_hoja(*h, desde);
+        while (true) {
+            const string* isbns = textos[nodo].isbns;
+            for (; i < h->n; ++i) {
+                if (h->claves[i] > hasta || !f(h->claves[i], isbns[i])) {
+                    return;
+                }
+            }
+            nodo = h->siguiente;
+            if (nodo == NULO) {
+                return;
+            }
+            h = &hojas[nodo];
+            i = 0;
+        }
+    }
+
+    // Función pública para obtener claves ordenadas
+    vector<pair<long long, string>> obtenerClavesOrdenadas() const {
+        vector<pair<long long, string>> claves;
+        claves.reserve(cantidad);
+        recorrer_rango(INT64_MIN, INT64_MAX, [&](long long k, const string& s) {
+            claves.push_back({ k, s });
+            return true;
+        });
+        return claves;
+    }
+};
+
+// ------------------ Internado de identificadores -----------------
+
+// Valor que devuelve Internador::buscar si la clave nunca se internó
+const uint32_t SIN_NUMERO = UINT32_MAX;
+
+// Asigna a cada clave (ISBN o ID de usuario) un número denso 0, 1, 2... la primera vez que
+// aparece. Las estructuras internas de varios saltos (grafo, colas, listas inversas) guardan
+// ese número: ocupa 4 bytes y su hash es trivial. La clave solo se recupera al escribir
+// archivos o mostrar datos. Los números no se reutilizan: un libro borrado conserva el suyo.
+// 'V' es el tipo con el que se busca (para cadenas, string_view apuntando a 'nombres').
+template <typename K, typename V = K>
+struct Internador {
+    // Claves por número (deque: las referencias no se mueven al crecer)
+    deque<K> nombres;
+    // Clave -> número
+    unordered_map<V, uint32_t> numeros;
+
+    // Número de la clave, asignándole uno nuevo si no lo tenía
+    // (si ya lo tenía solo consulta, así que puede llamarse desde varios hilos lectores)
+    uint32_t id(V s) {
+        auto it = numeros.find(s);
+        if (it != numeros.end()) {
+            return it->second;
+        }
+        uint32_t n = static_cast<uint32_t>(nombres.size());
+        nombres.emplace_back(s);
+        numeros.emplace(V(nombres.back()), n);
+        return n;
+    }
+
+    // Número de la clave sin asignar ninguno; SIN_NUMERO si no existe
+    uint32_t buscar(V s) const {
+        auto it = numeros.find(s);
+        return it == numeros.end() ? SIN_NUMERO : it->second;
+    }
+
+    // Clave de un número ya asignado
+    const K& nombre(uint32_t n) const {
+        return nombres[n];
+    }
+
+    // Cantidad de números asignados
+    size_t size() const {
+        return nombres.size();
+    }
+
+    // Reserva espacio para 'n' claves
+    void reservar(size_t n) {
+        numeros.reserve(n);
+    }
+};
+
+// ------------------ Claves empaquetadas -----------------
+// ISBNs e IDs de usuario guardados en 64 bits en lugar de un std::string. El texto se
+// conserva exacto (ceros a la izquierda incluidos), así que empaquetar y volver a escribir
+// da siempre la misma cadena (salvo la 'x' minúscula de un ISBN-10, que vuelve como 'X'):
+//   - solo cifras (hasta 16): bits 56-60 = cantidad de cifras, bits 0-55 = valor
+//   - ISBN-10 válido terminado en 'X': bit 62 + el ISBN-13 equivalente en los bits 0-55
+//   - cualquier otro texto: bit 63 + número en la tabla de textos libres (poco frecuente)
+
+// Marca de texto libre y de ISBN-10 con 'X'
+const uint64_t CLAVE_LIBRE = 1ULL << 63;
+const uint64_t CLAVE_ISBN10_X = 1ULL << 62;
+// Máscara del valor numérico y máximo de cifras que caben
+const uint64_t CLAVE_VALOR = (1ULL << 56) - 1;
+const size_t CLAVE_MAX_CIFRAS = 16;
+
+// Textos que no caben empaquetados; compartidos por todas las claves y protegidos con un
+// mutex porque la carga convierte filas en varios hilos
+struct TextosLibres {
+    mutex m;
+    Internador<string, string_view> textos;
+};
+TextosLibres& textos_libres() {
+    static TextosLibres t;
+    return t;
+}
+
+// Verdadero si 's' son solo cifras
+bool solo_cifras(string_view s) {
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Empaqueta un texto cualquiera (cifras o texto libre)
+uint64_t empaquetar_texto(string_view s) {
+    if (s.size() <= CLAVE_MAX_CIFRAS && solo_cifras(s)) {
+        uint64_t valor = 0;
+        for (char c : s) {
+            valor = valor * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return (static_cast<uint64_t>(s.size()) << 56) | valor;
+    }
+    TextosLibres& t = textos_libres();
+    lock_guard<mutex> lk(t.m);
+    return CLAVE_LIBRE | t.textos.id(s);
+}
+
+// Escribe 'cifras' cifras de 'valor' (con ceros a la izquierda) al final de 'out'
+void escribir_cifras(uint64_t valor, size_t cifras, string& out) {
+    out.resize(out.size() + cifras);
+    for (size_t i = 0; i < cifras; ++i) {
+        out[out.size() - 1 - i] = static_cast<char>('0' + valor % 10);
+        valor /= 10;
+    }
+}
+
+// Texto de una clave empaquetada con empaquetar_texto
+string desempaquetar_texto(uint64_t v) {
+    if (v & CLAVE_LIBRE) {
+        TextosLibres& t = textos_libres();
+        lock_guard<mutex> lk(t.m);
+        return t.textos.nombre(static_cast<uint32_t>(v & ~CLAVE_LIBRE));
+    }
+    string out;
+    escribir_cifras(v & CLAVE_VALOR, static_cast<size_t>((v >> 56) & 0x1F), out);
+    return out;
+}
+
+// Mezcla los bits de una clave para los mapas hash (finalizador de splitmix64)
+inline size_t mezclar_clave(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<size_t>(x);
+}
+
+// ISBN-13 (como número) a partir de los 9 primeros dígitos de un ISBN-10
+uint64_t isbn13_desde_isbn10(uint64_t nueve) {
+    uint64_t base = 978000000000ULL + nueve;
+    // Dígito de control del ISBN-13: pesos 1 y 3 alternados desde la izquierda
+    int suma = 0;
+    uint64_t x = base;
+    for (int i = 0; i < 12; ++i) {
+        int d = static_cast<int>(x % 10);
+        x /= 10;
+        suma += (i % 2 == 0) ? 3 * d : d;
+    }
+    return base * 10 + static_cast<uint64_t>((10 - suma % 10) % 10);
+}
+
+// ISBN-13 canónico (como número) de un texto con guiones o espacios opcionales:
+// un ISBN-13 con dígito de control correcto o un ISBN-10 válido (convertido). 0 si no lo es.
+uint64_t isbn13_canonico(string_view s) {
+    string d;
+    for (char c : s) {
+        if (c != '-' && c != ' ') {
+            d += c;
+        }
+    }
+    if (d.size() == 13 && solo_cifras(d)) {
+        int suma = 0;
+        for (int i = 0; i < 13; ++i) {
+            suma += (d[i] - '0') * (i % 2 == 0 ? 1 : 3);
+        }
+        return suma % 10 == 0 ? stoull(d) : 0;
+    }
+    if (d.size() == 10 && solo_cifras(d.substr(0, 9)) && (isdigit(static_cast<unsigned char>(d[9])) || d[9] == 'X' || d[9] == 'x')) {
+        // Dígito de control del ISBN-10: suma ponderada 10..1 múltiplo de 11 ('X' vale 10)
+        int suma = 0;
+        for (int i = 0; i < 10; ++i) {
+            int v = (i == 9 && (d[9] == 'X' || d[9] == 'x')) ? 10 : d[i] - '0';
+            suma += v * (10 - i);
+        }
+        return suma % 11 == 0 ? isbn13_desde_isbn10(stoull(d.substr(0, 9))) : 0;
+    }
+    return 0;
+}
+
+// ISBN empaquetado
+struct ClaveIsbn {
+    uint64_t v = 0;
+
+    // Empaqueta el texto de un ISBN (cualquier texto es aceptado y se conserva exacto)
+    static ClaveIsbn de(string_view s) {
+        ClaveIsbn k;
+        // Un ISBN-10 con 'X' no son solo cifras: se guarda como su ISBN-13 y una marca
+        // (una 'x' minúscula, frecuente al tipearlo a mano, es el mismo ISBN)
+        if (s.size() == 10 && toupper(static_cast<unsigned char>(s[9])) == 'X' && solo_cifras(s.substr(0, 9))) {
+            uint64_t isbn13 = isbn13_canonico(s);
+            if (isbn13 != 0) {
+                k.v = CLAVE_ISBN10_X | isbn13;
+                return k;
+            }
+        }
+        k.v = empaquetar_texto(s);
+        return k;
+    }
+
+    // Texto original del ISBN
+    string texto() const {
+        if (v & CLAVE_ISBN10_X) {
+            // Los 9 dígitos centrales del ISBN-13 son los del ISBN-10
+            string out;
+            escribir_cifras(((v & CLAVE_VALOR) / 10) % 1000000000ULL, 9, out);
+            out += 'X';
+            return out;
+        }
+        return desempaquetar_texto(v);
+    }
+
+    // ISBN-13 canónico como número (convierte los ISBN-10); 0 si el texto no es un ISBN válido
+    uint64_t canonica() const {
+        if (v & CLAVE_ISBN10_X) {
+            return v & CLAVE_VALOR;
+        }
+        return isbn13_canonico(texto());
+    }
+
+    bool operator==(const ClaveIsbn& o) const { return v == o.v; }
+    bool operator!=(const ClaveIsbn& o) const { return v != o.v; }
+};
+
+// ISBN escrito por el usuario tal como se guarda: un ISBN-10 válido terminado en 'x' pasa a
+// 'X' (cualquier otro texto queda igual)
+string normalizar_isbn(string s) {
+    if (s.size() == 10 && s[9] == 'x' && solo_cifras(string_view(s).substr(0, 9)) && isbn13_canonico(s) != 0) {
+        s[9] = 'X';
+    }
+    return s;
+}
+
+// ID de usuario empaquetado (los generados son 12 cifras)
+struct ClaveUsuario {
+    uint64_t v = 0;
+
+    // Empaqueta el texto de un ID (cualquier texto es aceptado y se conserva exacto)
+    static ClaveUsuario de(string_view s) {
+        ClaveUsuario k;
+        k.v = empaquetar_texto(s);
+        return k;
+    }
+
+    // Texto original del ID
+    string texto() const {
+        return desempaquetar_texto(v);
+    }
+
+    bool operator==(const ClaveUsuario& o) const { return v == o.v; }
+    bool operator!=(const ClaveUsuario& o) const { return v != o.v; }
+};
+
+// Hash de las claves empaquetadas para los contenedores unordered_*
+namespace std {
+template <>
+struct hash<ClaveIsbn> {
+    size_t operator()(const ClaveIsbn& k) const { return mezclar_clave(k.v); }
+};
+template <>
+struct hash<ClaveUsuario> {
+    size_t operator()(const ClaveUsuario& k) const { return mezclar_clave(k.v); }
+};
+}
+
+// Textos de una lista de claves (para escribirlas en archivos)
+template <typename K>
+vector<string> textos_de(const vector<K>& claves) {
+    vector<string> out;
+    out.reserve(claves.size());
+    for (const K& k : claves) {
+        out.push_back(k.texto());
+    }
+    return out;
+}
+
+// ------------------ Modelos de datos -----------------
+
+// Estructura que representa un libro en la biblioteca
+struct Libro {
+    // Identificador único del libro (cadena de texto)
+    string isbn;
+    // Versión numérica del ISBN para ordenamiento eficiente en AVL
+    long long isbn_num = 0;
+    // Título del libro
+    string titulo;
+    // Lista de autores del libro
+    vector<string> autores;
+    // Género literario
+    string genero;
+    // Fecha de publicación en formato YYYY-MM-DD
+    string fecha_publi;
+    // Cantidad total de copias físicas que posee la biblioteca
+    int copias_totales = 0;
+    // Cantidad de copias que están actualmente en estante (no prestadas)
+    int copias_disponibles = 0;
+};
+
+// Estructura que representa un usuario de la biblioteca
+struct Usuario {
+    // Identificador único del usuario
+    string id_usuario;
+    // Nombre completo del usuario
+    string nombre;
+    // Correo electrónico de contacto
+    string correo;
+    // Historial de ISBNs de libros que el usuario ha tomado prestados (histórico completo)
+    vector<ClaveIsbn> historial_isbn;
+    // Conjunto de ISBNs que el usuario tiene prestados ACTUALMENTE, sin repetidos y en orden
+    // de préstamo (son pocos: un vector de 8 bytes por libro se recorre más rápido que un hash)
+    vector<ClaveIsbn> prestamos_activos;
+    // Contador de cuántos libros tiene prestados en este momento
+    int num_prestamos_activos = 0;
+    // Historial de títulos de libros leídos (útil si el libro se borra del sistema después)
+    vector<string> historial_titulos;
+    // Línea ya codificada para usuarios.csv (vacía si hay que reconstruirla)
+    // Se invalida al cambiar los préstamos o el historial del usuario
+    mutable string fila_csv;
+    // Versión de los títulos del catálogo con la que se armó 'fila_csv' (solo importa si la
+    // fila reconstruye los títulos desde 'libros' porque historial_titulos está vacío)
+    mutable uint64_t version_fila = 0;
+
+    // Indica si el usuario tiene prestado 'isbn' ahora
+    bool tiene_activo(ClaveIsbn isbn) const {
+        return find(prestamos_activos.begin(), prestamos_activos.end(), isbn) != prestamos_activos.end();
+    }
+
+    // Agrega 'isbn' a los préstamos activos (si ya estaba no lo repite)
+    void agregar_activo(ClaveIsbn isbn) {
+        if (!tiene_activo(isbn)) {
+            prestamos_activos.push_back(isbn);
+        }
+    }
+
+    // Quita 'isbn' de los préstamos activos; retorna false si no estaba
+    bool quitar_activo(ClaveIsbn isbn) {
+        auto it = find(prestamos_activos.begin(), prestamos_activos.end(), isbn);
+        if (it == prestamos_activos.end()) {
+            return false;
+        }
+        prestamos_activos.erase(it);
+        return true;
+    }
+};
+
+// Estructura que representa un préstamo activo o inactivo
+struct Prestamo {
+    // Identificador único de la transacción de préstamo
+    string id_prestamo;
+    // Título del libro prestado (snapshot al momento del préstamo)
+    string titulo;
+    // ISBN del libro prestado
+    ClaveIsbn isbn;
+    // ID del usuario que tiene el libro
+    ClaveUsuario id_usuario;
+    // Estado del préstamo: true si el libro aún no se ha devuelto, false si ya se devolvió
+    bool activo = true;
+    // Fecha de devolución (AAAA-MM-DD); vacía mientras está activo o si no se conoce
+    string fecha_cierre;
+};
+
+// ------------------ Escaneo estructural del CSV -----------------
+// Un campo CSV termina en el primer delimitador o '\n' que quede fuera de comillas.
+// Como las comillas escapadas ("") siempre vienen en pares, "estar dentro de comillas"
+// equivale a que la cantidad de comillas vistas desde el inicio del campo sea impar.
+// Eso permite buscar el fin de campo con máscaras de bits: se comparan 16 o 32 bytes
+// a la vez contra '"', el delimitador y '\n', y un prefijo XOR sobre la máscara de
+// comillas marca qué bytes están dentro de comillas.
+
+// Busca desde 'i' el siguiente delimitador o '\n' fuera de comillas; retorna n si no hay.
+// Pone 'comillas' en true si el tramo recorrido contiene alguna comilla.
+using FuncionEscaneo = size_t (*)(const char* d, size_t i, size_t n, char delim, bool& comillas);
+
+// Variantes disponibles del escaneo
+enum ModoEscaneo { ESCANEO_ESCALAR, ESCANEO_SSE2, ESCANEO_AVX2 };
+
+// Recorrido byte a byte partiendo del estado 'dentro' (también termina los bloques vectoriales)
+inline size_t escanear_resto(const char* d, size_t i, size_t n, char delim, bool dentro, bool& comillas) {
+    for (; i < n; i++) {
+        char c = d[i];
+        if (c == '"') {
+            dentro = !dentro;
+            comillas = true;
+        }
+        else if (!dentro && (c == delim || c == '\n')) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Versión escalar (cualquier plataforma)
+size_t escanear_escalar(const char* d, size_t i, size_t n, char delim, bool& comillas) {
+    return escanear_resto(d, i, n, delim, false, comillas);
+}
+
+#ifdef BIBLIOTECA_SIMD_X86
+// Prefijo XOR: el bit i queda con la paridad de los bits 0..i de x
+inline uint32_t prefijo_xor(uint32_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    return x;
+}
+
+// Versión SSE2: bloques de 16 bytes
+__attribute__((target("sse2")))
+size_t escanear_sse2(const char* d, size_t i, size_t n, char delim, bool& comillas) {
+    const __m128i v_comilla = _mm_set1_epi8('"');
+    const __m128i v_delim = _mm_set1_epi8(delim);
+    const __m128i v_salto = _mm_set1_epi8('\n');
+    // Todos los bits a 1 si el bloque empieza dentro de comillas
+    uint32_t dentro = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(d + i));
+        uint32_t m_comillas = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_comilla));
+        uint32_t m_fin = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, v_delim), _mm_cmpeq_epi8(v, v_salto)));
+        uint32_t en_comillas = prefijo_xor(m_comillas) ^ dentro;
+        uint32_t estructural = m_fin & ~en_comillas & 0xFFFFu;
+        if (estructural) {
+            int k = __builtin_ctz(estructural);
+            if (m_comillas & ((1u << k) - 1)) {
+                comillas = true;
+            }
+            return i + k;
+        }
+        if (m_comillas) {
+            comillas = true;
+        }
+        // El bit 15 trae la paridad acumulada hasta el final del bloque
+        dentro = (en_comillas & 0x8000u) ? 0xFFFFFFFFu : 0;
+    }
+    return escanear_resto(d, i, n, delim, dentro != 0, comillas);
+}
+
+// Versión AVX2: bloques de 32 bytes
+__attribute__((target("avx2")))
+size_t escanear_avx2(const char* d, size_t i, size_t n, char delim, bool& comillas) {
+    const __m256i v_comilla = _mm256_set1_epi8('"');
+    const __m256i v_delim = _mm256_set1_epi8(delim);
+    const __m256i v_salto = _mm256_set1_epi8('\n');
+    uint32_t dentro = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(d + i));
+        uint32_t m_comillas = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_comilla));
+        uint32_t m_fin = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, v_delim), _mm256_cmpeq_epi8(v, v_salto)));
+        uint32_t en_comillas = prefijo_xor(m_comillas) ^ dentro;
+        uint32_t estructural = m_fin & ~en_comillas;
+        if (estructural) {
+            int k = __builtin_ctz(estructural);
+            if (m_comillas & ((1u << k) - 1)) {
+                comillas = true;
+            }
+            return i + k;
+        }
+        if (m_comillas) {
+            comillas = true;
+        }
+        // El bit 31 trae la paridad acumulada hasta el final del bloque
+        dentro = (en_comillas & 0x80000000u) ? 0xFFFFFFFFu : 0;
+    }
+    return escanear_resto(d, i, n, delim, dentro != 0, comillas);
+}
+#endif
+
+// Variante más rápida que soporta la CPU actual (se consulta una sola vez)
+ModoEscaneo mejor_modo_escaneo() {
+#ifdef BIBLIOTECA_SIMD_X86
+    static const ModoEscaneo modo = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? ESCANEO_AVX2 : ESCANEO_SSE2;
+    }();
+    return modo;
+#else
+    return ESCANEO_ESCALAR;
+#endif
+}
+
+// Función de escaneo para un modo (si no está disponible se usa la escalar)
+FuncionEscaneo funcion_escaneo(ModoEscaneo modo) {
+#ifdef BIBLIOTECA_SIMD_X86
+    if (modo == ESCANEO_AVX2 && mejor_modo_escaneo() == ESCANEO_AVX2) {
+        return escanear_avx2;
+    }
+    if (modo != ESCANEO_ESCALAR) {
+        return escanear_sse2;
+    }
+#else
+    (void)modo;
+#endif
+    return escanear_escalar;
+}
+
+// Nombre legible del modo (para los reportes del benchmark)
+const char* nombre_modo_escaneo(ModoEscaneo modo) {
+    switch (modo) {
+        case ESCANEO_AVX2: return "AVX2";
+        case ESCANEO_SSE2: return "SSE2";
+        default: return "escalar";
+    }
+}
+
+// Quita las comillas de un campo en su propio lugar ("" dentro de comillas = una comilla)
+// Retorna la nueva longitud del campo
+inline size_t quitar_comillas(char* campo, size_t largo) {
+    size_t escritura = 0;
+    bool en_comillas = false;
+    for (size_t i = 0; i < largo; i++) {
+        if (campo[i] == '"') {
+            // Comilla escapada dentro de comillas: se conserva una sola
+            if (en_comillas && i + 1 < largo && campo[i + 1] == '"') {
+                campo[escritura++] = '"';
+                i++;
+            }
+            else {
+                // Apertura o cierre de comillas: no forma parte del valor
+                en_comillas = !en_comillas;
+            }
+        }
+        else {
+            campo[escritura++] = campo[i];
+        }
+    }
+    return escritura;
+}
+
+// ------------------ Lector CSV -----------------
+// Tokenizador CSV sin copias: lee el archivo completo en un solo buffer y entrega
+// cada campo como string_view apuntando a ese buffer. Respeta campos entre comillas
+// (con comillas escapadas "" y saltos de línea dentro de las comillas); las comillas
+// se eliminan reescribiendo el campo dentro del mismo buffer, sin reservar memoria.
+// El fin de cada campo se busca con la variante de escaneo más rápida de la CPU.
+// Un lector puede dividirse en tramos de filas completas que se leen en paralelo.
+struct LectorCSV {
+    // Contenido completo del archivo (se modifica al quitar comillas; vacío en los tramos)
+    string buffer;
+    // Inicio de los datos: apunta a 'buffer' o, en un tramo, al buffer del lector original
+    char* datos = nullptr;
+    // Posición de lectura actual dentro de los datos
+    size_t pos = 0;
+    // Fin (exclusivo) de la zona a leer
+    size_t fin = 0;
+    // Delimitador de campos
+    char delimitador = ',';
+    // Verdadero si la última fila leída terminó en salto de línea (falso = fila cortada al final)
+    bool fila_completa = false;
+    // Búsqueda del fin de campo (escalar, SSE2 o AVX2)
+    FuncionEscaneo escanear = funcion_escaneo(mejor_modo_escaneo());
+
+    // Lee el archivo completo; retorna false si no se pudo abrir
+    bool abrir(const string& ruta, char delim) {
+        ifstream file(ruta, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        // Reserva el tamaño exacto y lee de una sola vez
+        file.seekg(0, ios::end);
+        buffer.resize((size_t)file.tellg());
+        file.seekg(0, ios::beg);
+        file.read(&buffer[0], (streamsize)buffer.size());
+        datos = &buffer[0];
+        pos = 0;
+        fin = buffer.size();
+        delimitador = delim;
+        return true;
+    }
+
+    // Usa 'texto' como contenido (en lugar de leerlo de un archivo)
+    void cargar(string texto, char delim) {
+        buffer = std::move(texto);
+        datos = &buffer[0];
+        pos = 0;
+        fin = buffer.size();
+        delimitador = delim;
+    }
+
+    // Reparte lo que falta por leer en hasta 'partes' tramos de tamaño parecido.
+    // Cada corte se hace tras un salto de línea fuera de comillas (la paridad de comillas
+    // se lleva desde 'pos', que siempre está al inicio de una fila). Los tramos apuntan a
+    // este buffer, así que el lector debe seguir vivo mientras se usen.
+    vector<LectorCSV> dividir(size_t partes) const {
+        vector<LectorCSV> tramos;
+        size_t inicio = pos;
+        // Paridad de comillas vistas entre 'pos' y 'contado'
+        bool dentro = false;
+        size_t contado = pos;
+        for (size_t k = 1; k < partes; ++k) {
+            size_t objetivo = pos + (fin - pos) * k / partes;
+            if (objetivo <= contado) {
+                continue;
+            }
+            // Las comillas son raras: se saltan de una en una con memchr hasta el objetivo
+            while (const char* q = (const char*)memchr(datos + contado, '"', objetivo - contado)) {
+                dentro = !dentro;
+                contado = (size_t)(q - datos) + 1;
+            }
+            // Avanza hasta el primer salto de línea fuera de comillas
+            size_t corte = objetivo;
+            for (; corte < fin; ++corte) {
+                if (datos[corte] == '"') {
+                    dentro = !dentro;
+                }
+                else if (datos[corte] == '\n' && !dentro) {
+                    break;
+                }
+            }
+            if (corte >= fin) {
+                break;
+            }
+            tramos.push_back(tramo(inicio, corte + 1));
+            inicio = contado = corte + 1;
+        }
+        tramos.push_back(tramo(inicio, fin));
+        return tramos;
+    }
+
+    // Lector sobre [desde, hasta) de estos mismos datos (sin copiar el buffer)
+    LectorCSV tramo(size_t desde, size_t hasta) const {
+        LectorCSV t;
+        t.datos = datos;
+        t.pos = desde;
+        t.fin = hasta;
+        t.delimitador = delimitador;
+        t.escanear = escanear;
+        return t;
+    }
+
+    // Lee la siguiente fila en 'campos' (el vector se reutiliza entre filas)
+    // Retorna false cuando ya no quedan filas
+    bool siguiente_fila(vector<string_view>& campos) {
+        campos.clear();
+        if (pos >= fin) {
+            return false;
+        }
+        const size_t n = fin;
+        fila_completa = false;
+        
+        while (true) {
+            // Fin del campo actual; solo se reescribe el campo si contenía comillas
+            bool comillas = false;
+            size_t fin_campo = escanear(datos, pos, n, delimitador, comillas);
+            size_t largo = comillas ? quitar_comillas(datos + pos, fin_campo - pos) : fin_campo - pos;
+            
+            if (fin_campo < n && datos[fin_campo] == '\n') {
+                // Fin de fila (se descarta un '\r' previo de finales de línea Windows)
+                if (largo > 0 && datos[pos + largo - 1] == '\r') {
+                    largo--;
+                }
+                campos.emplace_back(datos + pos, largo);
+                pos = fin_campo + 1;
+                fila_completa = true;
+                return true;
+            }
+            campos.emplace_back(datos + pos, largo);
+            if (fin_campo >= n) {
+                // Última fila sin salto de línea final
+                pos = n;
+                return true;
+            }
+            // Delimitador: sigue con el próximo campo
+            pos = fin_campo + 1;
+        }
+    }
+};
+
+// Elimina espacios en blanco al inicio y final de una vista (sin copiar)
+string_view trim_vista(string_view s) {
+    const char* whitespace = " \t\n\r";
+    size_t first = s.find_first_not_of(whitespace);
+    if (first == string_view::npos) {
+        return string_view();
+    }
+    size_t last = s.find_last_not_of(whitespace);
+    return s.substr(first, last - first + 1);
+}
+
+// Recorre los sub-campos no vacíos de 'campo' separados por 'sep', llamando a 'f' con cada vista
+template <typename F>
+void para_cada_subcampo(string_view campo, char sep, F f) {
+    size_t inicio = 0;
+    while (inicio <= campo.size()) {
+        size_t fin = campo.find(sep, inicio);
+        if (fin == string_view::npos) {
+            fin = campo.size();
+        }
+        if (fin > inicio) {
+            f(campo.substr(inicio, fin - inicio));
+        }
+        inicio = fin + 1;
+    }
+}
+
+// Convierte una vista a número con from_chars (sin excepciones)
+// Igual que stoi/stoll: ignora espacios iniciales, acepta un '+' delante de los dígitos e
+// ignora el texto sobrante tras ellos (from_chars solo no acepta ni espacios ni '+')
+template <typename T>
+bool convertir_numero(string_view s, T& valor) {
+    // Espacios iniciales (los mismos que salta stoi)
+    while (!s.empty() && isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    // Signo '+' explícito, solo si le sigue un dígito ("+-5" tampoco es válido para stoi)
+    if (s.size() > 1 && s[0] == '+' && isdigit(static_cast<unsigned char>(s[1]))) {
+        s.remove_prefix(1);
+    }
+    auto r = from_chars(s.data(), s.data() + s.size(), valor);
+    return r.ec == errc();
+}
+
+// ------------------ Hilos de carga -----------------
+// Número de hilos para la carga de los CSV (0 = uno por núcleo); se fija con --hilos N
+size_t hilos_carga_configurados = 0;
+
+// Hilos a usar en la carga según la configuración y los núcleos disponibles
+size_t hilos_de_carga() {
+    if (hilos_carga_configurados > 0) {
+        return hilos_carga_configurados;
+    }
+    unsigned nucleos = thread::hardware_concurrency();
+    return nucleos ? nucleos : 1;
+}
+
+// Ejecuta las tareas con hasta 'hilos' hilos (cada hilo toma la siguiente tarea libre)
+// y espera a que terminen todas. Con un solo hilo se ejecutan en orden en el hilo actual.
+void ejecutar_en_paralelo(const vector<function<void()>>& tareas, size_t hilos) {
+    hilos = min(hilos, tareas.size());
+    if (hilos <= 1) {
+        for (const auto& tarea : tareas) {
+            tarea();
+        }
+        return;
+    }
+    atomic<size_t> siguiente(0);
+    vector<thread> trabajadores;
+    for (size_t h = 0; h < hilos; ++h) {
+        trabajadores.emplace_back([&] {
+            for (size_t i = siguiente++; i < tareas.size(); i = siguiente++) {
+                tareas[i]();
+            }
+        });
+    }
+    for (thread& t : trabajadores) {
+        t.join();
+    }
+}
+
+// ------------------ Archivo mapeado en memoria -----------------
+// Abre un archivo en modo solo lectura y lo proyecta en memoria (mmap).
+// En plataformas sin mmap lee el archivo completo a un buffer.
+struct ArchivoMapeado {
+    // Puntero al inicio del contenido
+    const char* datos = nullptr;
+    // Tamaño del contenido en bytes
+    size_t tam = 0;
+#ifndef _WIN32
+    // Descriptor del archivo abierto
+    int fd = -1;
+#else
+    // Copia en memoria del archivo (alternativa sin mmap)
+    vector<char> buffer;
+#endif
+
+    // Abre y proyecta el archivo; retorna false si no existe o está vacío
+    bool abrir(const string& ruta) {
+#ifndef _WIN32
+        // Abre el descriptor en solo lectura
+        fd = ::open(ruta.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        // Consulta el tamaño del archivo
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            cerrar();
+            return false;
+        }
+        tam = (size_t)st.st_size;
+        // Proyecta el archivo completo como memoria de solo lectura
+        void* p = mmap(nullptr, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            tam = 0;
+            cerrar();
+            return false;
+        }
+        datos = static_cast<const char*>(p);
+        return true;
+#else
+        // Lee el archivo completo en el buffer
+        ifstream file(ruta, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        datos = buffer.data();
+        tam = buffer.size();
+        return tam > 0;
+#endif
+    }
+
+    // Libera la proyección y el descriptor
+    void cerrar() {
+#ifndef _WIN32
+        if (datos) {
+            munmap(const_cast<char*>(datos), tam);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+#else
+        buffer.clear();
+#endif
+        datos = nullptr;
+        tam = 0;
+    }
+
+    // El destructor libera automáticamente la proyección
+    ~ArchivoMapeado() {
+        cerrar();
+    }
+};
+
+// ------------------ Escritura atómica y durabilidad -----------------
+// Cuándo se fuerza la bitácora a disco (fsync) tras anotar una operación:
+//   NINGUNA   : solo se entrega al sistema operativo (un corte de luz puede perder lo último)
+//   GRUPO     : como mucho un fsync cada N ms; las operaciones intermedias viajan juntas
+//   OPERACION : la operación no retorna hasta que su registro pasó por un fsync (las que
+//               llegan juntas comparten el mismo; máxima seguridad, mayor latencia)
+enum NivelDurabilidad { DURABILIDAD_NINGUNA, DURABILIDAD_GRUPO, DURABILIDAD_OPERACION };
+
+// Tiempo acumulado en fsync para un archivo
+struct ContadorSync {
+    // Cantidad de fsync realizados
+    size_t llamadas = 0;
+    // Milisegundos totales dentro de fsync
+    double ms = 0;
+};
+
+// Qué hace una operación cuando la cola del hilo escritor está llena:
+//   BLOQUEAR : espera a que el escritor libere lugar (nunca pierde operaciones)
+//   RECHAZAR : la operación no se aplica y el llamador recibe un error
+enum PoliticaColaLlena { COLA_LLENA_BLOQUEAR, COLA_LLENA_RECHAZAR };
+
+// Métricas del hilo escritor de la bitácora
+struct MetricasEscritor {
+    // Registros esperando en la cola, máximo observado y capacidad
+    size_t profundidad = 0;
+    size_t profundidad_maxima = 0;
+    size_t capacidad = 0;
+    // Registros que llegaron a disco (o a una base compactada) y lotes escritos
+    size_t registros_escritos = 0;
+    size_t lotes = 0;
+    // Operaciones que esperaron lugar en la cola y operaciones rechazadas
+    size_t esperas = 0;
+    size_t rechazos = 0;
+    // Retraso entre que una operación se encola y su registro llega a la bitácora (ms)
+    double retraso_ultimo_ms = 0;
+    double retraso_maximo_ms = 0;
+    double retraso_total_ms = 0;
+};
+
+// Fuerza a disco el contenido de un archivo ya escrito; suma el tiempo a 'contador'
+bool sincronizar_archivo(const string& ruta, ContadorSync& contador) {
+    auto inicio = chrono::steady_clock::now();
+    bool ok = true;
+#ifndef _WIN32
+    int fd = ::open(ruta.c_str(), O_RDONLY);
+    ok = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#else
+    (void)ruta;
+#endif
+    contador.llamadas++;
+    contador.ms += chrono::duration<double, milli>(chrono::steady_clock::now() - inicio).count();
+    return ok;
+}
+
+// Fuerza a disco el directorio que contiene 'ruta' (para que un rename sobreviva a un corte)
+void sincronizar_directorio(const string& ruta) {
+#ifndef _WIN32
+    string dir = filesystem::path(ruta).parent_path().string();
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)ruta;
+#endif
+}
+
+// Archivo que se escribe en 'ruta.tmp' y solo reemplaza a 'ruta' al confirmar
+// (fsync del temporal + rename + fsync del directorio). Si el programa cae a mitad
+// de la escritura, 'ruta' conserva intacta su versión anterior.
+struct EscrituraAtomica {
+    // Destino final y archivo temporal
+    string ruta;
+    string temporal;
+    // Flujo sobre el temporal
+    ofstream file;
+    // Verdadero cuando el temporal ya reemplazó al destino (o quedó a cargo de una marca
+    // de compactación, que lo renombrará)
+    bool confirmada = false;
+
+    explicit EscrituraAtomica(const string& destino, ios::openmode modo = ios::out)
+        : ruta(destino), temporal(destino + ".tmp"), file(temporal, modo | ios::trunc) {}
+
+    // Cierra y fuerza a disco el temporal sin tocar el destino; retorna false si algo falla
+    bool preparar(ContadorSync& contador) {
+        file.close();
+        return !file.fail() && sincronizar_archivo(temporal, contador);
+    }
+
+    // Cierra, fuerza a disco y renombra sobre el destino; retorna false si algo falla
+    bool confirmar(ContadorSync& contador) {
+        if (!preparar(contador)) {
+            return false;
+        }
+        error_code ec;
+        filesystem::rename(temporal, ruta, ec);
+        if (ec) {
+            return false;
+        }
+        sincronizar_directorio(ruta);
+        confirmada = true;
+        return true;
+    }
+
+    // Si no se confirmó, se descarta el temporal y el destino queda como estaba
+    ~EscrituraAtomica() {
+        if (!confirmada) {
+            file.close();
+            error_code ec;
+            filesystem::remove(temporal, ec);
+        }
+    }
+};
+
+// ------------------ Instantánea binaria -----------------
+// Formato versionado de biblioteca.snap:
+//   [Cabecera][RegLibro...][RegUsuario...][RegPrestamo...][RegCola...][RefCadena de listas...][tabla de cadenas]
+// Los registros son de tamaño fijo; los textos se guardan una sola vez en la tabla de cadenas
+// y los registros los referencian por (offset, longitud). Las listas (autores, historiales,
+// colas) son rangos dentro de un arreglo común de referencias a cadenas.
+
+// Versión actual del formato (se incrementa ante cualquier cambio de disposición)
+const uint32_t SNAPSHOT_VERSION = 1;
+// Valor conocido para detectar archivos escritos con otro orden de bytes
+const uint32_t SNAPSHOT_MARCA_ENDIAN = 0x01020304;
+
+// Referencia a un texto dentro de la tabla de cadenas
+struct RefCadena {
+    uint32_t offset;
+    uint32_t longitud;
+};
+
+// Referencia a un rango dentro del arreglo de listas
+struct RefLista {
+    uint32_t inicio;
+    uint32_t cantidad;
+};
+
+// Cabecera del archivo: conteos y posición de cada sección
+struct CabeceraSnapshot {
+    char magia[8];
+    uint32_t version;
+    uint32_t marca_endian;
+    uint64_t num_libros;
+    uint64_t num_usuarios;
+    uint64_t num_prestamos;
+    uint64_t num_colas;
+    uint64_t num_listas;
+    uint64_t tam_cadenas;
+    uint64_t off_libros;
+    uint64_t off_usuarios;
+    uint64_t off_prestamos;
+    uint64_t off_colas;
+    uint64_t off_listas;
+    uint64_t off_cadenas;
+};
+
+// Registro fijo de un Libro
+struct RegLibro {
+    RefCadena isbn;
+    RefCadena titulo;
+    RefCadena genero;
+    RefCadena fecha_publi;
+    RefLista autores;
+    int64_t isbn_num;
+    int32_t copias_totales;
+    int32_t copias_disponibles;
+};
+
+// Registro fijo de un Usuario
+struct RegUsuario {
+    RefCadena id_usuario;
+    RefCadena nombre;
+    RefCadena correo;
+    RefLista prestamos_activos;
+    RefLista historial_isbn;
+    RefLista historial_titulos;
+    int32_t num_prestamos_activos;
+    int32_t reservado;
+};
+
+// Registro fijo de un Prestamo
+struct RegPrestamo {
+    RefCadena id_prestamo;
+    RefCadena titulo;
+    RefCadena isbn;
+    RefCadena id_usuario;
+    uint32_t activo;
+    uint32_t reservado;
+};
+
+// Registro fijo de una cola de espera (ISBN -> usuarios en orden)
+struct RegCola {
+    RefCadena isbn;
+    RefLista usuarios;
+};
+
+// Los registros se copian byte a byte: deben tener disposición fija
+static_assert(is_trivially_copyable<CabeceraSnapshot>::value && sizeof(CabeceraSnapshot) == 112, "Cabecera con disposicion inesperada");
+static_assert(sizeof(RegLibro) == 56 && sizeof(RegUsuario) == 56, "Registros de libro/usuario con disposicion inesperada");
+static_assert(sizeof(RegPrestamo) == 40 && sizeof(RegCola) == 16, "Registros de prestamo/cola con disposicion inesperada");
+
+// Acumula la tabla de cadenas y el arreglo de listas mientras se escribe una instantánea
+struct EscritorSnapshot {
+    // Bytes de todos los textos, sin separadores
+    string cadenas;
+    // Textos ya escritos -> su referencia (los ISBN e IDs repetidos se guardan una sola vez)
+    unordered_map<string, RefCadena> vistos;
+    // Arreglo común de listas
+    vector<RefCadena> listas;
+
+    // Añade (o reutiliza) un texto en la tabla de cadenas
+    RefCadena cadena(const string& s) {
+        auto it = vistos.find(s);
+        if (it != vistos.end()) {
+            return it->second;
+        }
+        RefCadena r{ (uint32_t)cadenas.size(), (uint32_t)s.size() };
+        cadenas += s;
+        vistos.emplace(s, r);
+        return r;
+    }
+
+    // Añade una lista de textos al arreglo común
+    template <typename Contenedor>
+    RefLista lista(const Contenedor& elementos) {
+        RefLista r{ (uint32_t)listas.size(), (uint32_t)elementos.size() };
+        for (const string& s : elementos) {
+            listas.push_back(cadena(s));
+        }
+        return r;
+    }
+};
+
+// Acceso de solo lectura a una instantánea proyectada en memoria
+struct LectorSnapshot {
+    // Archivo proyectado
+    ArchivoMapeado archivo;
+    // Copia de la cabecera validada
+    CabeceraSnapshot cab;
+
+    // Abre el archivo y valida magia, versión, orden de bytes y límites de cada sección
+    bool abrir(const string& ruta) {
+        if (!archivo.abrir(ruta) || archivo.tam < sizeof(CabeceraSnapshot)) {
+            return false;
+        }
+        memcpy(&cab, archivo.datos, sizeof(cab));
+        if (memcmp(cab.magia, "BIBSNAP", 8) != 0 || cab.version != SNAPSHOT_VERSION
+            || cab.marca_endian != SNAPSHOT_MARCA_ENDIAN) {
+            return false;
+        }
+        // Cada sección debe caber dentro del archivo
+        return seccion_valida(cab.off_libros, cab.num_libros, sizeof(RegLibro))
+            && seccion_valida(cab.off_usuarios, cab.num_usuarios, sizeof(RegUsuario))
+            && seccion_valida(cab.off_prestamos, cab.num_prestamos, sizeof(RegPrestamo))
+            && seccion_valida(cab.off_colas, cab.num_colas, sizeof(RegCola))
+            && seccion_valida(cab.off_listas, cab.num_listas, sizeof(RefCadena))
+            && seccion_valida(cab.off_cadenas, cab.tam_cadenas, 1);
+    }
+
+    // Verifica que [off, off + n * tam_reg) esté dentro del archivo
+    bool seccion_valida(uint64_t off, uint64_t n, uint64_t tam_reg) const {
+        return off <= archivo.tam && n <= (archivo.tam - off) / tam_reg;
+    }
+
+    // Copia el registro i de una sección (memcpy evita accesos desalineados)
+    template <typename Reg>
+    Reg registro(uint64_t off, uint64_t i) const {
+        Reg r;
+        memcpy(&r, archivo.datos + off + i * sizeof(Reg), sizeof(Reg));
+        return r;
+    }
+
+    // Texto referenciado (vacío si la referencia se sale de la tabla)
+    string cadena(RefCadena r) const {
+        if ((uint64_t)r.offset + r.longitud > cab.tam_cadenas) {
+            return "";
+        }
+        return string(archivo.datos + cab.off_cadenas + r.offset, r.longitud);
+    }
+
+    // Recorre los textos de una lista llamando a 'f' con cada uno
+    template <typename F>
+    void lista(RefLista l, F f) const {
+        if ((uint64_t)l.inicio + l.cantidad > cab.num_listas) {
+            return;
+        }
+        for (uint32_t i = 0; i < l.cantidad; ++i) {
+            f(cadena(registro<RefCadena>(cab.off_listas, l.inicio + i)));
+        }
+    }
+};
+
+// ------------------ Catálogo en columnas -----------------
+// Copia del catálogo organizada por columnas para los recorridos completos (búsqueda por
+// género, inventario): cada campo es un arreglo contiguo indexado por el número del ISBN, así
+// que un filtro lee solo las columnas que necesita en lugar de saltar entre los nodos del mapa
+// de libros. El mapa sigue siendo la fuente de verdad; la Biblioteca actualiza estas columnas
+// en cada alta, baja o cambio de copias.
+// Cada género distinto se normaliza una sola vez y guarda la lista ordenada de sus libros
+// (índice invertido), así que buscar por género recorre unos pocos cientos de géneros y no
+// todo el catálogo. Las fechas de publicación se indexan ordenadas (rangos, más recientes) y con
+// la cantidad de libros por año (histogramas).
+
+// Totales de un recorrido del catálogo
+struct ResumenCatalogo {
+    size_t libros = 0;
+    long long copias_totales = 0;
+    long long copias_disponibles = 0;
+
+    bool operator==(const ResumenCatalogo& o) const {
+        return libros == o.libros && copias_totales == o.copias_totales && copias_disponibles == o.copias_disponibles;
+    }
+};
+
+// Cantidad de días del mes 'mes' (1-12) del año 'anio'
+uint32_t dias_del_mes(uint32_t anio, uint32_t mes) {
+    static const uint32_t dias[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool bisiesto = (anio % 4 == 0 && anio % 100 != 0) || anio % 400 == 0;
+    return mes == 2 && bisiesto ? 29 : dias[mes - 1];
+}
+
+// Fecha AAAA-MM-DD como número AAAAMMDD (0 si no se puede leer), para comparar rangos con enteros
+// Solo acepta fechas reales: año 1-9999, mes 1-12 y día dentro del mes
+uint32_t empaquetar_fecha(string_view fecha) {
+    uint32_t partes[3] = { 0, 0, 0 };
+    size_t k = 0;
+    for (char c : fecha) {
+        if (c == '-') {
+            if (++k == 3) {
+                return 0;
+            }
+        }
+        else if (c >= '0' && c <= '9') {
+            partes[k] = partes[k] * 10 + static_cast<uint32_t>(c - '0');
+            // Un año de más de 4 cifras (o un mes o día larguísimo) no es una fecha
+            if (partes[k] > 9999) {
+                return 0;
+            }
+        }
+        else {
+            return 0;
+        }
+    }
+    if (k != 2 || partes[0] == 0 || partes[1] == 0 || partes[1] > 12
+        || partes[2] == 0 || partes[2] > dias_del_mes(partes[0], partes[1])) {
+        return 0;
+    }
+    return partes[0] * 10000 + partes[1] * 100 + partes[2];
+}
+
+// Extremo de un rango de fechas escrito como AAAA, AAAA-MM o AAAA-MM-DD: el inicio del periodo,
+// o su último día si 'final' (0 si no se puede leer)
+uint32_t limite_fecha(string fecha, bool final) {
+    if (fecha.size() == 4) {
+        fecha += final ? "-12-31" : "-01-01";
+    }
+    else if (fecha.size() == 7) {
+        // El último día del mes depende del mes (y del año en febrero)
+        uint32_t inicio = empaquetar_fecha(fecha + "-01");
+        if (inicio == 0) {
+            return 0;
+        }
+        return final ? inicio - 1 + dias_del_mes(inicio / 10000, inicio / 100 % 100) : inicio;
+    }
+    return empaquetar_fecha(fecha);
+}
+
+// Normaliza un género para compararlo: minúsculas y solo caracteres alfanuméricos
+string normalizar_genero(string g) {
+    // Transforma la cadena a minúsculas
+    transform(g.begin(), g.end(), g.begin(),
+        [](unsigned char c) { return tolower(c); });
+        
+    // Elimina caracteres no alfanuméricos (espacios, símbolos)
+    g.erase(remove_if(g.begin(), g.end(),
+        [](unsigned char c) { return !isalnum(c); }), g.end());
+    return g;
+}
+
+struct CatalogoColumnas {
+    // 1 si el número corresponde a un libro del catálogo (los borrados quedan en 0)
+    vector<uint8_t> vivo;
+    vector<int32_t> copias_totales;
+    vector<int32_t> copias_disponibles;
+    // Número del género en 'generos'
+    vector<uint32_t> genero;
+    // Fecha de publicación AAAAMMDD
+    vector<uint32_t> fecha;
+    vector<ClaveIsbn> isbn;
+    // Título y autores (separados por '^') dentro de 'textos'. Un texto nuevo que entra en el
+    // lugar del anterior lo reemplaza ahí; uno más largo se añade al final y el viejo queda sin
+    // usar hasta compactar_textos()
+    vector<RefCadena> titulo;
+    vector<RefCadena> autores;
+    string textos;
+    // Bytes de 'textos' que ya no usa ningún libro
+    size_t textos_sin_usar = 0;
+    // Diccionario de géneros (texto exacto -> número)
+    Internador<string, string_view> generos;
+    // Por número de género: su texto normalizado y sus libros vivos en orden de número
+    vector<string> genero_normalizado;
+    vector<vector<uint32_t>> libros_genero;
+    // Libros con fecha legible ordenados por (fecha, número), y cantidad de libros por año
+    set<pair<uint32_t, uint32_t>> por_fecha;
+    map<uint32_t, size_t> libros_por_anio;
+
+    // Cantidad de posiciones (números de ISBN asignados hasta ahora)
+    size_t size() const {
+        return vivo.size();
+    }
+
+    // Si el libro número 'n' está en el catálogo
+    bool contiene(uint32_t n) const {
+        return n < vivo.size() && vivo[n];
+    }
+
+    // Agranda las columnas para que quepan 'n' posiciones
+    void reservar(size_t n) {
+        if (n <= vivo.size()) {
+            return;
+        }
+        vivo.resize(n, 0);
+        copias_totales.resize(n, 0);
+        copias_disponibles.resize(n, 0);
+        genero.resize(n, 0);
+        fecha.resize(n, 0);
+        isbn.resize(n);
+        titulo.resize(n, RefCadena{ 0, 0 });
+        autores.resize(n, RefCadena{ 0, 0 });
+    }
+
+    // Guarda un texto en 'textos' y retorna su referencia
+    RefCadena guardar_texto(string_view s) {
+        RefCadena r{ static_cast<uint32_t>(textos.size()), static_cast<uint32_t>(s.size()) };
+        textos.append(s.data(), s.size());
+        return r;
+    }
+
+    // Texto guardado con guardar_texto
+    string_view texto(RefCadena r) const {
+        return string_view(textos).substr(r.offset, r.longitud);
+    }
+
+    // Cambia el texto de 'r' por 's': si no cambió no hace nada, si entra en su lugar lo
+    // escribe ahí y si no lo añade al final
+    void reescribir_texto(RefCadena& r, string_view s) {
+        if (texto(r) == s) {
+            return;
+        }
+        if (s.size() <= r.longitud) {
+            textos.replace(r.offset, s.size(), s.data(), s.size());
+            textos_sin_usar += r.longitud - s.size();
+            r.longitud = static_cast<uint32_t>(s.size());
+            return;
+        }
+        textos_sin_usar += r.longitud;
+        r = guardar_texto(s);
+    }
+
+    // Rearma 'textos' con solo los textos en uso (los de libros borrados también quedan)
+    void compactar_textos() {
+        string nuevo;
+        nuevo.reserve(textos.size() - textos_sin_usar);
+        for (size_t n = 0; n < titulo.size(); ++n) {
+            for (RefCadena* r : { &titulo[n], &autores[n] }) {
+                string_view t = texto(*r);
+                r->offset = static_cast<uint32_t>(nuevo.size());
+                nuevo.append(t.data(), t.size());
+            }
+        }
+        textos = std::move(nuevo);
+        textos_sin_usar = 0;
+    }
+
+    // Número del género 'g' (un género nuevo se normaliza y recibe su lista vacía)
+    uint32_t numero_genero(const string& g) {
+        uint32_t n = generos.id(g);
+        if (n == libros_genero.size()) {
+            genero_normalizado.push_back(normalizar_genero(g));
+            libros_genero.emplace_back();
+        }
+        return n;
+    }
+
+    // Añade el libro 'n' a la lista de su género, manteniéndola ordenada
+    // (en la carga los números llegan en orden y basta con agregarlos al final)
+    void agregar_a_genero(uint32_t g, uint32_t n) {
+        vector<uint32_t>& lista = libros_genero[g];
+        if (lista.empty() || lista.back() < n) {
+            lista.push_back(n);
+        }
+        else {
+            lista.insert(lower_bound(lista.begin(), lista.end(), n), n);
+        }
+    }
+
+    // Quita el libro 'n' de la lista de su género
+    void quitar_de_genero(uint32_t g, uint32_t n) {
+        vector<uint32_t>& lista = libros_genero[g];
+        auto it = lower_bound(lista.begin(), lista.end(), n);
+        if (it != lista.end() && *it == n) {
+            lista.erase(it);
+        }
+    }
+
+    // Añade el libro 'n' publicado en 'f' al índice de fechas (las fechas ilegibles no se indexan)
+    void agregar_a_fechas(uint32_t f, uint32_t n) {
+        if (f == 0) {
+            return;
+        }
+        por_fecha.insert({ f, n });
+        libros_por_anio[f / 10000]++;
+    }
+
+    // Quita el libro 'n' publicado en 'f' del índice de fechas
+    void quitar_de_fechas(uint32_t f, uint32_t n) {
+        if (f == 0 || !por_fecha.erase({ f, n })) {
+            return;
+        }
+        auto it = libros_por_anio.find(f / 10000);
+        if (--it->second == 0) {
+            libros_por_anio.erase(it);
+        }
+    }
+
+    // Escribe (o reescribe) el libro 'n'
+    void poner(uint32_t n, ClaveIsbn clave, const Libro& l) {
+        reservar(static_cast<size_t>(n) + 1);
+        uint32_t g = numero_genero(l.genero);
+        uint32_t f = empaquetar_fecha(l.fecha_publi);
+        // Solo cambian los índices si el libro es nuevo o cambió de género o de fecha
+        if (!vivo[n] || genero[n] != g) {
+            if (vivo[n]) {
+                quitar_de_genero(genero[n], n);
+            }
+            agregar_a_genero(g, n);
+        }
+        if (!vivo[n] || fecha[n] != f) {
+            if (vivo[n]) {
+                quitar_de_fechas(fecha[n], n);
+            }
+            agregar_a_fechas(f, n);
+        }
+        vivo[n] = 1;
+        copias_totales[n] = l.copias_totales;
+        copias_disponibles[n] = l.copias_disponibles;
+        genero[n] = g;
+        fecha[n] = f;
+        isbn[n] = clave;
+        reescribir_texto(titulo[n], l.titulo);
+        string unidos;
+        for (size_t i = 0; i < l.autores.size(); ++i) {
+            if (i > 0) {
+                unidos += '^';
+            }
+            unidos += l.autores[i];
+        }
+        reescribir_texto(autores[n], unidos);
+    }
+
+    // Marca el libro 'n' como fuera del catálogo
+    void quitar(uint32_t n) {
+        if (n < vivo.size() && vivo[n]) {
+            quitar_de_genero(genero[n], n);
+            quitar_de_fechas(fecha[n], n);
+            vivo[n] = 0;
+        }
+    }
+
+    // Libros publicados entre 'desde' y 'hasta' (AAAAMMDD, inclusive), del más antiguo al más reciente
+    vector<uint32_t> publicados_entre(uint32_t desde, uint32_t hasta) const {
+        vector<uint32_t> resultado;
+        auto fin = por_fecha.upper_bound({ hasta, SIN_NUMERO });
+        for (auto it = por_fecha.lower_bound({ desde, 0 }); it != fin; ++it) {
+            resultado.push_back(it->second);
+        }
+        return resultado;
+    }
+
+    // Los 'cantidad' libros publicados más recientemente, del más nuevo al más viejo
+    vector<uint32_t> mas_recientes(size_t cantidad) const {
+        vector<uint32_t> resultado;
+        for (auto it = por_fecha.rbegin(); it != por_fecha.rend() && resultado.size() < cantidad; ++it) {
+            resultado.push_back(it->second);
+        }
+        return resultado;
+    }
+
+    // Cantidad de libros por periodo de 'anios' años (1 = por año, 10 = por década), con cada
+    // periodo identificado por su primer año; solo aparecen los periodos con algún libro
+    vector<pair<uint32_t, size_t>> histograma_fechas(uint32_t anios) const {
+        vector<pair<uint32_t, size_t>> resultado;
+        for (const auto& par : libros_por_anio) {
+            uint32_t periodo = par.first / anios * anios;
+            if (resultado.empty() || resultado.back().first != periodo) {
+                resultado.push_back({ periodo, 0 });
+            }
+            resultado.back().second += par.second;
+        }
+        return resultado;
+    }
+
+    // Libros (en orden de número) cuyo género normalizado contiene 'busqueda' (ya normalizada):
+    // se compara contra el diccionario de géneros y se mezclan las listas de los que coinciden
+    vector<uint32_t> libros_con_genero(const string& busqueda) const {
+        vector<uint32_t> resultado, mezcla;
+        for (size_t g = 0; g < libros_genero.size(); ++g) {
+            const vector<uint32_t>& lista = libros_genero[g];
+            if (lista.empty() || genero_normalizado[g].find(busqueda) == string::npos) {
+                continue;
+            }
+            if (resultado.empty()) {
+                resultado = lista;
+            }
+            else {
+                mezcla.clear();
+                mezcla.reserve(resultado.size() + lista.size());
+                merge(resultado.begin(), resultado.end(), lista.begin(), lista.end(), back_inserter(mezcla));
+                resultado.swap(mezcla);
+            }
+        }
+        return resultado;
+    }
+
+    // Totales de los libros del género 'g' (SIN_NUMERO = todos) publicados entre 'desde' y
+    // 'hasta' (AAAAMMDD, inclusive). Sin saltos dentro del bucle: cada posición suma 0 o 1
+    ResumenCatalogo resumir(uint32_t g, uint32_t desde, uint32_t hasta) const {
+        ResumenCatalogo r;
+        const size_t n = vivo.size();
+        const bool todos = g == SIN_NUMERO;
+        size_t libros = 0;
+        long long totales = 0, disponibles = 0;
+        for (size_t i = 0; i < n; ++i) {
+            int m = vivo[i] & (todos | (genero[i] == g)) & (fecha[i] >= desde) & (fecha[i] <= hasta);
+            libros += m;
+            totales += m * copias_totales[i];
+            disponibles += m * copias_disponibles[i];
+        }
+        r.libros = libros;
+        r.copias_totales = totales;
+        r.copias_disponibles = disponibles;
+        return r;
+    }
+};
+
+// ------------------ Biblioteca -----------------
+// Clase principal que gestiona toda la lógica del sistema
+class Biblioteca {
+private:
+    // --- Persistencia CSV ---
+    // Nombre del archivo para guardar libros
+    const string LIBROS_CSV = "libros.csv";
+    // Nombre del archivo para guardar usuarios
+    const string USUARIOS_CSV = "usuarios.csv";
+    // Nombre del archivo para guardar préstamos
+    const string PRESTAMOS_CSV = "prestamos.csv";
+    // Nombre del archivo para guardar la lista de espera
+    const string LISTA_ESPERA_CSV = "lista_espera.csv";
+    // Nombre del archivo de la bitácora de operaciones (journal de escritura anticipada)
+    const string BITACORA_CSV = "bitacora.csv";
+    // Nombre del archivo de la instantánea binaria
+    const string SNAPSHOT_BIN = "biblioteca.snap";
+    // Marca de un reemplazo de bases decidido pero quizá sin terminar (ver reemplazar_bases)
+    const string COMPACTACION_PENDIENTE = "compactacion.pendiente";
+    // Directorio del archivo de préstamos cerrados (un CSV por mes de cierre)
+    const string ARCHIVO_PRESTAMOS = "archivo_prestamos/";
+
+    // Tablas que se persisten en CSV (sirven de índice para su estado de volcado)
+    enum Tabla { TABLA_LIBROS, TABLA_USUARIOS, TABLA_PRESTAMOS, TABLA_LISTA_ESPERA, NUM_TABLAS };
+
+    // Política de volcado de una tabla: se reescribe su CSV tras N mutaciones o T milisegundos
+    struct PoliticaVolcado {
+        // Mutaciones acumuladas que disparan el volcado
+        size_t max_mutaciones = 1000;
+        // Milisegundos desde la primera mutación pendiente que disparan el volcado
+        long long max_ms = 30000;
+    };
+
+    // Estado de volcado de una tabla
+    struct EstadoTabla {
+        // Verdadero si la memoria tiene cambios que su CSV aún no refleja
+        bool sucia = false;
+        // Mutaciones aplicadas desde el último volcado
+        size_t mutaciones = 0;
+        // Momento de la primera mutación pendiente
+        chrono::steady_clock::time_point primera_mutacion;
+        // Política que decide cuándo volcar
+        PoliticaVolcado politica;
+    };
+    // Delimitador usado en los archivos CSV (coma)
+    static const char DELIMITADOR = ',';
+
+    // Base de datos en memoria: ISBN -> Objeto Libro
+    unordered_map<string, Libro> libros;
+    // Base de datos en memoria: ID Usuario -> Objeto Usuario
+    unordered_map<string, Usuario> usuarios;
+    // Números densos de ISBNs y de IDs de usuario (ver Internador)
+    Internador<ClaveIsbn> isbns;
+    Internador<ClaveUsuario> ids_usuario;
+    // Cola de espera: número de ISBN -> Cola de números de usuarios esperando ese libro
+    unordered_map<uint32_t, queue<uint32_t>> lista_espera;
+    // Índice secundario ordenado por (Título, ISBN): permite listar alfabéticamente y
+    // admite varias ediciones con el mismo título
+    set<pair<string, string>> indice;
+    // Inverso del índice: ISBN -> Título con el que figura (para quitarlo en O(log n))
+    unordered_map<string, string> titulo_indexado;
+    // Estructura Trie para autocompletado y búsqueda por prefijo
+    Trie trie;
+    // Árbol AVL para ordenar libros por ISBN numérico
+    AVL isbn_avl;
+    // Mapa para conectar: Texto de búsqueda (normalizado) -> Números de ISBNs coincidentes
+    unordered_map<string, vector<uint32_t>> mapa_busqueda;
+    // Préstamos activos en memoria: ID Préstamo -> Objeto Préstamo
+    // (los cerrados pasan al archivo de préstamos y no vuelven a cargarse)
+    unordered_map<string, Prestamo> prestamos;
+    // Préstamos cerrados que aún no se anotaron en el archivo (se anotan al compactar)
+    vector<Prestamo> prestamos_cerrados;
+    // Índice de préstamos activos: clave_prestamo(usuario, ISBN) -> IDs de préstamo (en orden
+    // de alta; casi siempre uno). Permite cerrar una devolución sin recorrer 'prestamos'
+    unordered_map<uint64_t, vector<string>> prestamo_activo;
+    // Listas inversas para las cascadas (pueden tener de más, nunca de menos; quien las
+    // recorre comprueba cada registro):
+    // Número de ISBN -> números de usuarios que lo tienen prestado o lo leyeron
+    unordered_map<uint32_t, unordered_set<uint32_t>> lectores_libro;
+    // Número de ISBN -> IDs de sus préstamos activos
+    unordered_map<uint32_t, unordered_set<string>> prestamos_libro;
+    // Número de usuario -> IDs de sus préstamos activos
+    unordered_map<uint32_t, unordered_set<string>> prestamos_usuario;
+    // Grafo para recomendaciones: posición = número de ISBN A -> (número de ISBN B -> Peso de conexión)
+    vector<unordered_map<uint32_t, int>> grafico_libro;
+    // Catálogo en columnas por número de ISBN (recorridos por género e inventario)
+    CatalogoColumnas catalogo;
+    // Mapa auxiliar (parece redundante con Usuario::historial_isbn, pero se mantiene según original)
+    unordered_map<string, unordered_set<string>> libros_usuario;
+    // Cambia cada vez que un libro aparece o desaparece sin cascada sobre los usuarios;
+    // invalida las líneas de usuarios.csv que reconstruyen títulos desde el catálogo
+    uint64_t version_titulos = 0;
+
+    // Flujo de escritura abierto en modo append sobre la bitácora
+    ofstream bitacora;
+    // Estado de volcado (bandera de sucio, contador y política) de cada tabla
+    EstadoTabla tablas[NUM_TABLAS];
+    // Verdadero si la base de arranque es la instantánea binaria en lugar de los CSV
+    bool modo_snapshot = false;
+    // Verdadero si en modo instantánea los CSV quedaron atrasados respecto a la memoria
+    bool csv_desactualizados = false;
+    // Milisegundos que tomó leer las tablas al arrancar (sin contar el grafo)
+    double ms_carga_tablas = 0;
+    // Cuándo se fuerza la bitácora a disco y plazo del modo por grupos
+    // (atómicos: se pueden cambiar con el hilo escritor en marcha)
+    atomic<NivelDurabilidad> durabilidad{ DURABILIDAD_GRUPO };
+    atomic<long long> ms_grupo{ 1000 };
+    // Verdadero si hay registros de la bitácora entregados al sistema pero sin fsync
+    bool bitacora_sin_sync = false;
+    // Momento del último fsync de la bitácora
+    chrono::steady_clock::time_point ultimo_sync_bitacora;
+    // Tiempo en fsync por tabla, de la bitácora y de la instantánea
+    ContadorSync sync_tablas[NUM_TABLAS];
+    ContadorSync sync_bitacora;
+    ContadorSync sync_snapshot;
+    // Tiempo en fsync de los segmentos del archivo de préstamos
+    ContadorSync sync_archivo;
+
+    // Registro de la bitácora a la espera del hilo escritor
+    struct RegistroPendiente {
+        // Tipo de operación y campos, tal como se escriben en la línea
+        vector<string> campos;
+        // Momento en que se encoló (para medir el retraso)
+        chrono::steady_clock::time_point encolado;
+        // Número correlativo del registro (para esperar su fsync)
+        uint64_t numero = 0;
+    };
+    // Protege la memoria (mapas e índices) entre las operaciones y el hilo escritor
+    // Orden de los candados: mutex_disco -> mutex_estado -> mutex_cola
+    mutex mutex_estado;
+    // Protege la cola, su configuración y las métricas
+    mutex mutex_cola;
+    // Serializa la escritura de los archivos base (CSV e instantánea) y del archivo de préstamos
+    mutex mutex_disco;
+    // Registros aplicados en memoria y pendientes de anotar
+    deque<RegistroPendiente> cola_escritura;
+    // Capacidad de la cola y comportamiento al llenarse
+    size_t capacidad_cola = 4096;
+    // Lugares tomados por operaciones en curso que todavía no encolaron su registro
+    // (la cola nunca supera capacidad_cola - reservados)
+    size_t reservados = 0;
+    PoliticaColaLlena politica_cola = COLA_LLENA_BLOQUEAR;
+    // Verdadero si la última operación se rechazó por la cola llena
+    bool ultima_rechazada = false;
+    // Despierta al escritor (registros nuevos o cierre) y a los productores (lugar libre)
+    condition_variable cv_escritor;
+    condition_variable cv_productor;
+    // Último número de registro encolado y último que ya llegó a disco (fsync de la
+    // bitácora o base reemplazada); con durabilidad por operación se espera al segundo
+    uint64_t registros_encolados = 0;
+    uint64_t registros_sincronizados = 0;
+    condition_variable cv_sincronizado;
+    // Mayor número de registro que el escritor tomó de la cola (solo el hilo escritor)
+    uint64_t registros_tomados = 0;
+    // Último número de registro que encoló cada hilo (lo consulta su reserva al terminar)
+    inline static thread_local uint64_t ultimo_registro_hilo = 0;
+    // Pide al escritor que termine tras vaciar la cola
+    bool cerrando = false;
+    // Métricas del escritor (bajo mutex_cola)
+    MetricasEscritor metricas;
+    // Hilo que anota la bitácora, sincroniza y compacta
+    thread escritor;
+
+    // Enumeración para definir los tipos de acciones que se pueden deshacer
+   enum class TipoAccion { 
+        AgregarLibro,
+        EliminarLibro,
+        ModificarLibro,
+        AgregarUsuario,
+        EliminarUsuario,
+        PrestarLibro,
+        DevolverLibro,
+        PonerenCola
+    };
+    
+    // Estructura para registrar una acción en el historial (Pila de deshacer)
+    struct Accion {
+        TipoAccion tipo;
+        string id;      // ID principal afectado (ej. ISBN o ID Usuario)
+        string usuario; // ID secundario afectado (ej. Usuario en préstamo)
+        string datos;   // Datos extra si se requieren para restaurar estado
+    };
+
+    // Vector que funciona como pila para almacenar el historial de acciones
+    vector<Accion> historial_acciones;
+
+    // Función privada para añadir una acción al historial
+    void registrar_accion(const Accion& a) { 
+        // Empuja la acción al final del vector
+        historial_acciones.push_back(a); 
+    }
+    
+    // --- Manejo de comillas/comas en CSV ---
+    // Escapa cadenas para formato CSV (si tienen comas o comillas, las envuelve en comillas)
+    static string csv_quote(const string& s) {
+        // Verifica si la cadena necesita ser escapada (contiene delimitador o comillas)
+        if (s.find(DELIMITADOR) == string::npos && s.find('"') == string::npos) {
+            // Si es segura, la retorna tal cual
+            return s;
+        }
+        // Inicia la cadena de salida con una comilla de apertura
+        string out = "\"";
+        // Recorre cada carácter de la cadena original
+        for (char c : s) {
+            // Si encuentra una comilla doble, debe duplicarla para escaparla (regla CSV)
+            if (c == '"') {
+                out += "\"\"";
+            }
+            else {
+                // Si es un carácter normal, lo añade
+                out.push_back(c);
+            }
+        }
+        // Cierra la cadena con una comilla
+        out += "\"";
+        // Retorna la cadena formateada
+        return out;
+    }
+
+    // Función auxiliar para unir un vector de strings en una sola cadena con separador
+    static string join(const vector<string>& v, const string& sep) {
+        // String acumulador
+        string out;
+        // Itera por los elementos del vector
+        for (size_t i = 0; i < v.size(); ++i) {
+            // Si no es el primer elemento, añade el separador antes
+            if (i) {
+                out += sep;
+            }
+            // Añade el elemento actual
+            out += v[i];
+        }
+        // Retorna la cadena unida
+        return out;
+    }
+    // Construye un Libro a partir de 7 campos consecutivos (mismo orden que libros.csv)
+    // Retorna false si las copias no son numéricas
+    static bool libro_desde_campos(const vector<string_view>& campos, size_t base, Libro& l) {
+        // Asigna el ISBN dejando solo dígitos para consistencia (campo 0)
+        l.isbn.clear();
+        for (char c : campos[base + 0]) {
+            if (isdigit(static_cast<unsigned char>(c))) {
+                l.isbn.push_back(c);
+            }
+        }
+        
+        // Asigna el título limpiando espacios (campo 1)
+        l.titulo = string(trim_vista(campos[base + 1]));
+        
+        // Procesa los autores (campo 2), separados internamente por '^'
+        l.autores.clear();
+        para_cada_subcampo(campos[base + 2], '^', [&](string_view autor) {
+            l.autores.emplace_back(autor);
+        });
+        
+        // Asigna el género (campo 3)
+        l.genero = string(trim_vista(campos[base + 3]));
+        // Asigna la fecha de publicación (campo 4)
+        l.fecha_publi = string(campos[base + 4]);
+        
+        // Convierte copias totales y disponibles (campos 5 y 6); si no son números, falla
+        if (!convertir_numero(campos[base + 5], l.copias_totales)
+            || !convertir_numero(campos[base + 6], l.copias_disponibles)) {
+            return false;
+        }
+        
+        // Convierte el ISBN a número (para AVL); si no cabe o está vacío, queda en 0
+        if (!convertir_numero(string_view(l.isbn), l.isbn_num)) {
+            l.isbn_num = 0;
+        }
+        return true;
+    }
+
+    // Serializa un Libro en 7 campos (mismo orden que libros.csv)
+    static vector<string> campos_libro(const Libro& b) {
+        return { b.isbn, b.titulo, join(b.autores, "^"), b.genero, b.fecha_publi,
+                 to_string(b.copias_totales), to_string(b.copias_disponibles) };
+    }
+
+    // --- Funciones de CSV ---
+    
+    // --- Carga paralela de los CSV ---
+    // Filas ya convertidas de un tramo del archivo (y sus mensajes de error, en orden)
+    template <typename T>
+    struct TramoLeido {
+        vector<T> filas;
+        vector<string> errores;
+    };
+    // Tabla leída de disco: el lector es dueño del buffer al que apuntan los tramos
+    template <typename T>
+    struct TablaLeida {
+        LectorCSV lector;
+        bool existe = false;
+        vector<TramoLeido<T>> tramos;
+    };
+    // Tamaño mínimo de un tramo: por debajo no compensa repartir un archivo entre hilos
+    static const size_t TAM_MIN_TRAMO = 1 << 20;
+
+    // Descarta el encabezado, divide el resto de la tabla en tramos y agrega a 'tareas'
+    // la conversión de cada uno. 'convertir(campos, tramo)' agrega la fila convertida al tramo.
+    template <typename T, typename F>
+    static void preparar_tramos(TablaLeida<T>& tabla, size_t hilos, vector<function<void()>>& tareas, F convertir) {
+        if (!tabla.existe) {
+            return;
+        }
+        vector<string_view> encabezado;
+        tabla.lector.siguiente_fila(encabezado);
+        // Un tramo por hilo, salvo que el archivo sea pequeño
+        size_t partes = max<size_t>(1, min(hilos, (tabla.lector.fin - tabla.lector.pos) / TAM_MIN_TRAMO));
+        vector<LectorCSV> lectores = tabla.lector.dividir(partes);
+        tabla.tramos.resize(lectores.size());
+        for (size_t i = 0; i < lectores.size(); ++i) {
+            tareas.push_back([&tabla, i, lector = lectores[i], convertir]() mutable {
+                vector<string_view> campos;
+                while (lector.siguiente_fila(campos)) {
+                    convertir(campos, tabla.tramos[i]);
+                }
+            });
+        }
+    }
+
+    // Registros mínimos por tramo al decodificar una sección de la instantánea
+    static const size_t MIN_REGISTROS_TRAMO = 1 << 14;
+
+    // Reparte los 'n' registros de una sección de la instantánea en tramos contiguos y agrega
+    // a 'tareas' la decodificación de cada uno. 'decodificar(i, tramo)' agrega el registro i al tramo.
+    template <typename T, typename F>
+    static void preparar_tramos_snapshot(TablaLeida<T>& tabla, uint64_t n, size_t hilos, vector<function<void()>>& tareas, F decodificar) {
+        tabla.existe = true;
+        size_t partes = (size_t)max<uint64_t>(1, min<uint64_t>(hilos, n / MIN_REGISTROS_TRAMO));
+        tabla.tramos.resize(partes);
+        for (size_t k = 0; k < partes; ++k) {
+            uint64_t desde = n * k / partes;
+            uint64_t hasta = n * (k + 1) / partes;
+            tareas.push_back([&tabla, k, desde, hasta, decodificar]() {
+                TramoLeido<T>& tramo = tabla.tramos[k];
+                tramo.filas.reserve(hasta - desde);
+                for (uint64_t i = desde; i < hasta; ++i) {
+                    decodificar(i, tramo);
+                }
+            });
+        }
+    }
+
+    // Cantidad total de filas convertidas de una tabla
+    template <typename T>
+    static size_t total_filas(const TablaLeida<T>& tabla) {
+        size_t total = 0;
+        for (const auto& tramo : tabla.tramos) {
+            total += tramo.filas.size();
+        }
+        return total;
+    }
+
+    // Carga libros, usuarios, préstamos y lista de espera desde los CSV en cuatro etapas:
+    // 1) los cuatro archivos se leen a la vez; 2) cada archivo se parte en tramos de filas
+    // completas y todos los tramos se convierten en paralelo; 3) se muestran los mensajes
+    // de carga en el orden de siempre; 4) las filas se fusionan en orden de archivo con un
+    // hilo por estructura destino (mapas, índice de títulos, Trie, mapa de búsqueda y AVL),
+    // de modo que el resultado es idéntico al de la carga secuencial (fusionar_tablas).
+    void cargarTablasCSV() {
+        size_t hilos = hilos_de_carga();
+        TablaLeida<Libro> t_libros;
+        TablaLeida<Usuario> t_usuarios;
+        TablaLeida<Prestamo> t_prestamos;
+        TablaLeida<pair<string, queue<string>>> t_colas;
+
+        // 1. Lectura de los cuatro archivos
+        ejecutar_en_paralelo({
+            [&] { t_libros.existe = t_libros.lector.abrir(LIBROS_CSV, DELIMITADOR); },
+            [&] { t_usuarios.existe = t_usuarios.lector.abrir(USUARIOS_CSV, DELIMITADOR); },
+            [&] { t_prestamos.existe = t_prestamos.lector.abrir(PRESTAMOS_CSV, DELIMITADOR); },
+            [&] { t_colas.existe = t_colas.lector.abrir(LISTA_ESPERA_CSV, DELIMITADOR); }
+        }, hilos);
+
+        // 2. Conversión de las filas, tramo a tramo
+        vector<function<void()>> tareas;
+        // Libros: isbn, titulo, autores, genero, fecha_publi, copias_totales, copias_disponibles
+        preparar_tramos(t_libros, hilos, tareas, [](const vector<string_view>& campos, TramoLeido<Libro>& tramo) {
+            if (campos.size() < 7) {
+                return;
+            }
+            Libro l;
+            // Si las copias no son numéricas se ignora el libro (el error se muestra en la etapa 3)
+            if (!libro_desde_campos(campos, 0, l)) {
+                tramo.errores.push_back("Error al convertir copias del libro: " + string(campos[0]));
+                return;
+            }
+            tramo.filas.push_back(std::move(l));
+        });
+        // Usuarios: id, nombre, correo, prestamos_activos, historial_isbn, historial_titulos
+        preparar_tramos(t_usuarios, hilos, tareas, [](const vector<string_view>& campos, TramoLeido<Usuario>& tramo) {
+            if (campos.size() < 6) {
+                return;
+            }
+            Usuario u;
+            u.id_usuario = string(campos[0]);
+            u.nombre = string(campos[1]);
+            u.correo = string(campos[2]);
+            // Listas separadas por '^'
+            para_cada_subcampo(campos[3], '^', [&](string_view isbn_pa) {
+                u.agregar_activo(ClaveIsbn::de(isbn_pa));
+            });
+            para_cada_subcampo(campos[4], '^', [&](string_view isbn_h) {
+                u.historial_isbn.push_back(ClaveIsbn::de(isbn_h));
+            });
+            para_cada_subcampo(campos[5], '^', [&](string_view tit) {
+                u.historial_titulos.emplace_back(tit);
+            });
+            tramo.filas.push_back(std::move(u));
+        });
+        // Préstamos: id_prestamo, isbn, id_usuario, nombre_usuario, titulo, activo
+        preparar_tramos(t_prestamos, hilos, tareas, [](const vector<string_view>& campos, TramoLeido<Prestamo>& tramo) {
+            if (campos.size() < 6) {
+                return;
+            }
+            Prestamo p;
+            p.id_prestamo = string(campos[0]);
+            p.isbn = ClaveIsbn::de(campos[1]);
+            p.id_usuario = ClaveUsuario::de(campos[2]);
+            // Convierte el texto "true" o "false" a booleano
+            p.activo = (campos[5] == "true");
+            tramo.filas.push_back(std::move(p));
+        });
+        // Lista de espera: isbn, usuarios en cola separados por '^' (las colas vacías se ignoran)
+        preparar_tramos(t_colas, hilos, tareas, [](const vector<string_view>& campos, TramoLeido<pair<string, queue<string>>>& tramo) {
+            if (campos.size() < 2) {
+                return;
+            }
+            queue<string> q;
+            para_cada_subcampo(campos[1], '^', [&](string_view u) {
+                q.emplace(u);
+            });
+            if (!q.empty()) {
+                tramo.filas.emplace_back(string(campos[0]), std::move(q));
+            }
+        });
+        ejecutar_en_paralelo(tareas, hilos);
+
+        // 3. Mensajes (las tablas que faltan se crean vacías, salvo libros)
+        if (t_libros.existe) {
+            for (const auto& tramo : t_libros.tramos) {
+                for (const string& error : tramo.errores) {
+                    cerr << error << endl;
+                }
+            }
+            cout << "Libros cargados desde " << LIBROS_CSV << endl;
+        }
+        else {
+            cout << "Archivo " << LIBROS_CSV << " no encontrado." << endl;
+        }
+        if (t_usuarios.existe) {
+            cout << "Usuarios cargados desde " << USUARIOS_CSV << endl;
+        }
+        else {
+            cout << "Archivo " << USUARIOS_CSV << " no encontrado. Creando archivo vacío." << endl;
+            guardarTablaCSV(TABLA_USUARIOS);
+        }
+        if (t_prestamos.existe) {
+            cout << "Prestamos cargados desde " << PRESTAMOS_CSV << endl;
+        }
+        else {
+            cout << "Archivo " << PRESTAMOS_CSV << " no encontrado. Creando archivo vacío." << endl;
+            guardarTablaCSV(TABLA_PRESTAMOS);
+        }
+        if (t_colas.existe) {
+            cout << "Lista de espera cargada desde " << LISTA_ESPERA_CSV << endl;
+        }
+        else {
+            cout << "Archivo " << LISTA_ESPERA_CSV << " no encontrado. Creando archivo vacío." << endl;
+            guardarTablaCSV(TABLA_LISTA_ESPERA);
+        }
+
+        fusionar_tablas(t_libros, t_usuarios, t_prestamos, t_colas, hilos);
+    }
+
+    // Etapas finales de la carga, comunes a los CSV y a la instantánea: reparte los números
+    // densos y fusiona las filas ya convertidas en todas las estructuras (con los mapas
+    // reservados de antemano para el total de filas)
+    void fusionar_tablas(TablaLeida<Libro>& t_libros, TablaLeida<Usuario>& t_usuarios, TablaLeida<Prestamo>& t_prestamos,
+                         TablaLeida<pair<string, queue<string>>>& t_colas, size_t hilos) {
+        // 1. Números densos: se asignan antes de fusionar (los libros primero, en orden de
+        // archivo) para que en la fusión los hilos solo consulten los internadores
+        ejecutar_en_paralelo({
+            [&] {
+                isbns.reservar(total_filas(t_libros));
+                for (const auto& tramo : t_libros.tramos) {
+                    for (const Libro& l : tramo.filas) {
+                        isbns.id(ClaveIsbn::de(l.isbn));
+                    }
+                }
+                for (const auto& tramo : t_prestamos.tramos) {
+                    for (const Prestamo& p : tramo.filas) {
+                        isbns.id(p.isbn);
+                    }
+                }
+            },
+            [&] {
+                ids_usuario.reservar(total_filas(t_usuarios));
+                for (const auto& tramo : t_usuarios.tramos) {
+                    for (const Usuario& u : tramo.filas) {
+                        ids_usuario.id(ClaveUsuario::de(u.id_usuario));
+                    }
+                }
+                for (const auto& tramo : t_prestamos.tramos) {
+                    for (const Prestamo& p : tramo.filas) {
+                        ids_usuario.id(p.id_usuario);
+                    }
+                }
+            }
+        }, hilos);
+
+        // 2. Fusión: cada estructura la llena un solo hilo, recorriendo las filas en orden
+        libros.reserve(total_filas(t_libros));
+        usuarios.reserve(total_filas(t_usuarios));
+        prestamos.reserve(total_filas(t_prestamos));
+        prestamo_activo.reserve(total_filas(t_prestamos));
+        // Recorre los libros en orden de archivo
+        auto para_cada_libro = [&](auto f) {
+            for (const auto& tramo : t_libros.tramos) {
+                for (const Libro& l : tramo.filas) {
+                    f(l);
+                }
+            }
+        };
+        // Recorre los términos de búsqueda de un libro (título y autores), ya normalizados
+        auto para_cada_termino = [](const Libro& l, auto f) {
+            if (!l.titulo.empty()) {
+                f(normalizar_termino(l.titulo));
+            }
+            for (const string& autor : l.autores) {
+                if (!autor.empty()) {
+                    f(normalizar_termino(autor));
+                }
+            }
+        };
+        ejecutar_en_paralelo({
+            // Mapa principal de libros
+            [&] { para_cada_libro([&](const Libro& l) { libros[l.isbn] = l; }); },
+            // Índice de títulos
+            [&] { para_cada_libro([&](const Libro& l) { indexar_titulo(l.isbn, l.titulo); }); },
+            // Trie de autocompletado
+            [&] {
+                para_cada_libro([&](const Libro& l) {
+                    para_cada_termino(l, [&](const string& termino) { trie.insertar(termino); });
+                });
+            },
+            // Término normalizado -> ISBNs
+            [&] {
+                para_cada_libro([&](const Libro& l) {
+                    uint32_t n = isbns.buscar(ClaveIsbn::de(l.isbn));
+                    para_cada_termino(l, [&](const string& termino) { mapa_busqueda[termino].push_back(n); });
+                });
+            },
+            // Catálogo en columnas
+            [&] {
+                catalogo.reservar(isbns.size());
+                para_cada_libro([&](const Libro& l) {
+                    ClaveIsbn clave = ClaveIsbn::de(l.isbn);
+                    catalogo.poner(isbns.buscar(clave), clave, l);
+                });
+            },
+            // Árbol AVL por ISBN numérico
+            [&] {
+                para_cada_libro([&](const Libro& l) {
+                    if (l.isbn_num != 0) {
+                        isbn_avl.insertar(l.isbn_num, l.isbn);
+                    }
+                });
+            },
+            // Usuarios, préstamos y colas (sus filas ya no se necesitan: se mueven)
+            [&] {
+                for (auto& tramo : t_usuarios.tramos) {
+                    for (Usuario& u : tramo.filas) {
+                        string id = u.id_usuario;
+                        usuarios[id] = std::move(u);
+                    }
+                }
+            },
+            [&] {
+                for (auto& tramo : t_prestamos.tramos) {
+                    for (Prestamo& p : tramo.filas) {
+                        // Un prestamos.csv anterior al archivo puede traer préstamos cerrados
+                        if (!p.activo) {
+                            prestamos_cerrados.push_back(std::move(p));
+                            continue;
+                        }
+                        indexar_prestamo(p);
+                        string id = p.id_prestamo;
+                        prestamos[id] = std::move(p);
+                    }
+                }
+            }
+        }, hilos);
+
+        // 3. Colas de espera (pocas filas; pueden nombrar IDs nuevos, así que van después)
+        for (auto& tramo : t_colas.tramos) {
+            for (auto& fila : tramo.filas) {
+                queue<uint32_t>& q = lista_espera[isbns.id(ClaveIsbn::de(fila.first))];
+                q = queue<uint32_t>();
+                while (!fila.second.empty()) {
+                    q.push(ids_usuario.id(ClaveUsuario::de(fila.second.front())));
+                    fila.second.pop();
+                }
+            }
+        }
+    }
+
+    // Ruta del CSV de una tabla
+    const string& ruta_tabla(Tabla t) const {
+        switch (t) {
+            case TABLA_LIBROS: return LIBROS_CSV;
+            case TABLA_USUARIOS: return USUARIOS_CSV;
+            case TABLA_PRESTAMOS: return PRESTAMOS_CSV;
+            default: return LISTA_ESPERA_CSV;
+        }
+    }
+
+    // Contenido completo del CSV de una tabla (solo lee la memoria)
+    string serializarTabla(Tabla t) const {
+        ostringstream out;
+        switch (t) {
+            case TABLA_LIBROS: escribirLibrosCSV(out); break;
+            case TABLA_USUARIOS: escribirUsuariosCSV(out); break;
+            case TABLA_PRESTAMOS: escribirPrestamosCSV(out); break;
+            default: escribirListaEsperaCSV(out); break;
+        }
+        return out.str();
+    }
+
+    // Reemplaza 'ruta' por 'contenido' con escritura atómica; el fsync se suma a 'contador'
+    // Retorna false si no se pudo (y entonces 'ruta' queda como estaba)
+    static bool escribir_archivo(const string& ruta, const string& contenido, ContadorSync& contador,
+                                 ios::openmode modo = ios::out) {
+        EscrituraAtomica salida(ruta, modo);
+        if (!salida.file.is_open()) {
+            cerr << "Error: No se pudo abrir " << ruta << " para escritura." << endl;
+            return false;
+        }
+        salida.file.write(contenido.data(), (streamsize)contenido.size());
+        if (!salida.confirmar(contador)) {
+            cerr << "Error: No se pudo guardar " << ruta << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Guarda el estado actual de una tabla en su CSV
+    void guardarTablaCSV(Tabla t) {
+        escribir_archivo(ruta_tabla(t), serializarTabla(t), sync_tablas[t]);
+    }
+
+    // Escribe el contenido completo de libros.csv en 'file'
+    void escribirLibrosCSV(ostream& file) const {
+        // Escribe el encabezado del CSV
+        file << "isbn,titulo,autores,genero,fecha_publi,copias_totales,copias_disponibles\n";
+        
+        // Itera sobre todos los libros en memoria
+        for (const auto& pair : libros) {
+            // Obtiene referencia al objeto libro
+            const Libro& b = pair.second;
+            // Convierte el vector de autores a string separado por '^'
+            string autores_str = join(b.autores, "^");
+            
+            // Escribe los campos en el archivo, usando csv_quote para seguridad
+            file << csv_quote(b.isbn) << DELIMITADOR
+                << csv_quote(b.titulo) << DELIMITADOR
+                << csv_quote(autores_str) << DELIMITADOR
+                << csv_quote(b.genero) << DELIMITADOR
+                << csv_quote(b.fecha_publi) << DELIMITADOR
+                << b.copias_totales << DELIMITADOR
+                << b.copias_disponibles << "\n"; // Salto de línea al final
+        }
+    }
+
+    // Función para construir el grafo de recomendaciones basado en historiales
+    // Con varios hilos, cada uno arma solo las filas del grafo cuyo número de ISBN de origen
+    // le toca (número % hilos): ninguna fila se comparte entre hilos y cada una recibe sus
+    // aristas en el mismo orden que en la construcción secuencial.
+    void inicializarGrafo() {
+        // Limpia cualquier dato previo en el grafo; una fila por libro que exista
+        grafico_libro.clear();
+        grafico_libro.resize(isbns.size());
+        // Qué números corresponden a libros que siguen en el catálogo
+        vector<bool> vivo(isbns.size(), false);
+        for (const auto& par : libros) {
+            vivo[isbns.buscar(ClaveIsbn::de(par.first))] = true;
+        }
+        
+        // Los usuarios se reparten en tramos contiguos, uno por parte: cada par de un historial
+        // se calcula una sola vez, en la parte dueña del usuario
+        vector<const Usuario*> lista_usuarios;
+        lista_usuarios.reserve(usuarios.size());
+        for (const auto& par_u : usuarios) {
+            lista_usuarios.push_back(&par_u.second);
+        }
+        size_t n_partes = max<size_t>(1, min(hilos_de_carga(), lista_usuarios.size()));
+        // Conexiones que encontró cada parte, separadas por la parte dueña de la fila de destino
+        // (fila % n_partes): solo se anotan (fila, columna), la suma se hace al juntarlas. Con
+        // una sola parte se escribe directo en el grafo
+        vector<vector<vector<pair<uint32_t, uint32_t>>>> parciales(n_partes, vector<vector<pair<uint32_t, uint32_t>>>(n_partes));
+        vector<function<void()>> tareas;
+        for (size_t k = 0; k < n_partes; ++k) {
+            tareas.push_back([this, k, n_partes, &vivo, &lista_usuarios, &parciales] {
+                // Suma 1 a la conexión a -> b
+                auto sumar = [&](uint32_t a, uint32_t b) {
+                    if (n_partes == 1) {
+                        grafico_libro[a][b] += 1;
+                    }
+                    else {
+                        parciales[k][a % n_partes].push_back({ a, b });
+                    }
+                };
+                // Números de los libros del historial que siguen existiendo
+                // (se calcula una vez por libro y no una vez por par)
+                vector<uint32_t> num;
+                size_t desde = lista_usuarios.size() * k / n_partes;
+                size_t hasta = lista_usuarios.size() * (k + 1) / n_partes;
+                // Itera sobre los usuarios de este tramo
+                for (size_t x = desde; x < hasta; ++x) {
+                    // Obtiene referencia al usuario
+                    const Usuario& u = *lista_usuarios[x];
+                    num.clear();
+                    for (ClaveIsbn isbn : u.historial_isbn) {
+                        // Un libro que existe siempre tiene número (se interna al darlo de alta)
+                        uint32_t numero = isbns.buscar(isbn);
+                        if (numero != SIN_NUMERO && vivo[numero]) {
+                            num.push_back(numero);
+                        }
+                    }
+                    const size_t n = num.size();
+                    
+                    // Bucle anidado para comparar todos los libros que ha leído este usuario entre sí
+                    // Itera desde el primer libro del historial
+                    for (size_t i = 0; i < n; ++i) {
+                        // Itera desde el siguiente libro (para hacer pares únicos)
+                        for (size_t j = i + 1; j < n; ++j) {
+                            // Incrementa el peso de la conexión isbn1 -> isbn2
+                            sumar(num[i], num[j]);
+                            // Incrementa el peso de la conexión inversa (grafo no dirigido)
+                            sumar(num[j], num[i]);
+                        }
+                    }
+                }
+            });
+        }
+        ejecutar_en_paralelo(tareas, n_partes);
+        if (n_partes == 1) {
+            return;
+        }
+
+        // Cada parte junta en sus filas los pesos que le dejaron todas las demás (ninguna otra
+        // parte escribe en esas filas)
+        tareas.clear();
+        for (size_t k = 0; k < n_partes; ++k) {
+            tareas.push_back([this, k, n_partes, &parciales] {
+                for (size_t t = 0; t < n_partes; ++t) {
+                    for (const auto& par : parciales[t][k]) {
+                        grafico_libro[par.first][par.second] += 1;
+                    }
+                    // Libera la parcial apenas se usa
+                    vector<pair<uint32_t, uint32_t>>().swap(parciales[t][k]);
+                }
+            });
+        }
+        ejecutar_en_paralelo(tareas, n_partes);
+    }
+    // Escribe el contenido completo de usuarios.csv en 'file'
+    void escribirUsuariosCSV(ostream& file) const {
+        // Escribe la cabecera del CSV
+        file << "id_usuario,nombre,correo,prestamos_activos,historial_isbn,historial_titulos_lectura\n";
+        
+        // Itera sobre todos los usuarios en memoria; los que no cambiaron reutilizan su línea
+        for (const auto& pair : usuarios) {
+            file << fila_usuario(pair.second);
+        }
+    }
+
+    // Verdadero si la línea del usuario toma los títulos del catálogo actual
+    static bool fila_depende_de_libros(const Usuario& u) {
+        return u.historial_titulos.empty() && !u.historial_isbn.empty();
+    }
+
+    // Línea de usuarios.csv de un usuario; se arma solo si su caché fue invalidada
+    const string& fila_usuario(const Usuario& u) const {
+        // La caché vale si existe y, cuando depende del catálogo, si este no cambió desde entonces
+        if (!u.fila_csv.empty() && (!fila_depende_de_libros(u) || u.version_fila == version_titulos)) {
+            return u.fila_csv;
+        }
+        
+        // Serializa el set de préstamos activos a un string separado por '^'
+        string prestamos_str = join(textos_de(u.prestamos_activos), "^");
+        
+        // Serializa el historial de ISBNs a un string separado por '^'
+        string historial_isbn_str = join(textos_de(u.historial_isbn), "^");
+        
+        // --- Lógica para reconstruir historial de títulos ---
+        // Vector temporal para los títulos
+        vector<string> historial_titulos_vec;
+        
+        // Si el usuario ya tenía un historial de títulos explícito (cargado o guardado previamente)
+        // se usa tal cual: esto es crucial para preservar títulos de libros que ya se eliminaron
+        if (!u.historial_titulos.empty()) {
+            historial_titulos_vec = u.historial_titulos;
+        }
+        else {
+            // Si no, recorre el historial de ISBNs para buscar los títulos actuales
+            for (ClaveIsbn isbn : u.historial_isbn) {
+                auto it = libros.find(isbn.texto());
+                // Si el libro existe en la base de datos actual
+                if (it != libros.end()) {
+                    // Obtiene el título real y actualizado
+                    historial_titulos_vec.push_back(it->second.titulo);
+                }
+                else {
+                    // Si el libro fue borrado, marca como NO ENCONTRADO temporalmente
+                    historial_titulos_vec.push_back("ISBN_NO_ENCONTRADO");
+                }
+            }
+        }
+        
+        // Serializa el vector de títulos a string separado por '^'
+        string historial_titulos_str = join(historial_titulos_vec, "^");
+        
+        // Arma la línea completa, entrecomillando cada campo, y la deja en caché
+        string fila;
+        fila += csv_quote(u.id_usuario);
+        fila += DELIMITADOR;
+        fila += csv_quote(u.nombre);
+        fila += DELIMITADOR;
+        fila += csv_quote(u.correo);
+        fila += DELIMITADOR;
+        fila += csv_quote(prestamos_str);
+        fila += DELIMITADOR;
+        fila += csv_quote(historial_isbn_str);
+        fila += DELIMITADOR;
+        fila += csv_quote(historial_titulos_str);
+        fila += '\n';
+        u.fila_csv = std::move(fila);
+        u.version_fila = version_titulos;
+        return u.fila_csv;
+    }
+    // --- Cargar/Guardar prestamos ---
+    
+    // Escribe el contenido completo de prestamos.csv en 'file' (solo los préstamos activos;
+    // los cerrados viven en el archivo de préstamos)
+    void escribirPrestamosCSV(ostream& file) const {
+        // Escribe encabezado
+        file << "id_prestamo,isbn,id_usuario,nombre_usuario,titulo,activo\n";
+        
+        // Itera sobre el mapa de préstamos
+        for (const auto& pair : prestamos) {
+            // Referencia al objeto préstamo
+            const Prestamo& p = pair.second;
+            // Textos de las claves del préstamo
+            string isbn = p.isbn.texto();
+            string id_usuario = p.id_usuario.texto();
+            
+            // Busca el nombre del usuario para guardarlo como referencia legible (desnormalización)
+            // Si el usuario ya no existe, pone "NO ENCONTRADO"
+            auto it_usuario = usuarios.find(id_usuario);
+            string nombre_usuario = it_usuario != usuarios.end() ? it_usuario->second.nombre : "NO ENCONTRADO";
+            
+            // Busca el título del libro para referencia legible
+            auto it_libro = libros.find(isbn);
+            string titulo_libro = it_libro != libros.end() ? it_libro->second.titulo : "NO ENCONTRADO";
+            
+            // Convierte el booleano a string "true"/"false"
+            string activo_str = p.activo ? "true" : "false";
+            
+            // Escribe la línea CSV con todos los campos entrecomillados
+            file << csv_quote(p.id_prestamo) << DELIMITADOR
+                << csv_quote(isbn) << DELIMITADOR
+                << csv_quote(id_usuario) << DELIMITADOR
+                << csv_quote(nombre_usuario) << DELIMITADOR
+                << csv_quote(titulo_libro) << DELIMITADOR
+                << activo_str << "\n";
+        }
+    }
+
+    // Escribe el contenido completo de lista_espera.csv en 'file'
+    void escribirListaEsperaCSV(ostream& file) const {
+        // Escribe encabezado
+        file << "isbn,cola_usuarios\n";
+        
+        // Itera sobre el mapa de listas de espera
+        for (auto& p : lista_espera) {
+            // ISBN (clave)
+            string isbn = isbns.nombre(p.first).texto();
+            // Copia temporal de la cola porque 'std::queue' no es iterable directamente
+            // y al hacer pop() la vaciamos, así que necesitamos una copia para no borrar la memoria RAM
+            queue<uint32_t> q = p.second; 
+            
+            // Vector para construir la cadena
+            vector<string> usuarios_vec;
+            
+            // Vacía la copia de la cola para llenar el vector (los números vuelven a ser IDs)
+            while (!q.empty()) {
+                usuarios_vec.push_back(ids_usuario.nombre(q.front()).texto());
+                q.pop();
+            }
+            
+            // Une el vector en un string separado por '^'
+            string cadena = join(usuarios_vec, "^");
+            
+            // Solo guardamos la línea si hay gente esperando
+            if (!cadena.empty()) {
+                file << csv_quote(isbn) << DELIMITADOR << csv_quote(cadena) << "\n";
+            }
+        }
+    }
+
+    // --- Archivo de préstamos cerrados (archivo_prestamos/) ---
+    // Un préstamo devuelto sale de 'prestamos' y, al compactar, se añade al segmento de su
+    // mes de cierre (prestamos_AAAA-MM.csv; los de fecha desconocida van a prestamos_sin_fecha.csv).
+    // Los segmentos solo crecen: no se reescriben ni se cargan al arrancar, y las consultas
+    // de historial los leen a pedido.
+
+    // Fecha de hoy en formato AAAA-MM-DD
+    static string fecha_actual() {
+        time_t ahora = time(nullptr);
+        tm local{};
+#ifndef _WIN32
+        localtime_r(&ahora, &local);
+#else
+        localtime_s(&local, &ahora);
+#endif
+        char texto[16];
+        strftime(texto, sizeof(texto), "%Y-%m-%d", &local);
+        return texto;
+    }
+
+    // Periodo (segmento) al que pertenece una fecha de cierre: AAAA-MM, o "sin_fecha"
+    static string periodo_de(const string& fecha) {
+        return fecha.size() >= 7 ? fecha.substr(0, 7) : "sin_fecha";
+    }
+
+    // Ruta del segmento del archivo para un periodo
+    string ruta_segmento(const string& periodo) const {
+        return ARCHIVO_PRESTAMOS + "prestamos_" + periodo + ".csv";
+    }
+
+    // Líneas de los préstamos cerrados pendientes, agrupadas por periodo (solo lee la memoria)
+    map<string, string> serializarCerrados() const {
+        map<string, string> segmentos;
+        for (const Prestamo& p : prestamos_cerrados) {
+            // Nombre y título legibles, como en prestamos.csv
+            string isbn = p.isbn.texto();
+            string id_usuario = p.id_usuario.texto();
+            auto it_u = usuarios.find(id_usuario);
+            auto it_l = libros.find(isbn);
+            string nombre_usuario = it_u != usuarios.end() ? it_u->second.nombre : "NO ENCONTRADO";
+            string titulo_libro = it_l != libros.end() ? it_l->second.titulo : (p.titulo.empty() ? "NO ENCONTRADO" : p.titulo);
+            
+            string& linea = segmentos[periodo_de(p.fecha_cierre)];
+            linea += csv_quote(p.id_prestamo);
+            linea += DELIMITADOR;
+            linea += csv_quote(isbn);
+            linea += DELIMITADOR;
+            linea += csv_quote(id_usuario);
+            linea += DELIMITADOR;
+            linea += csv_quote(nombre_usuario);
+            linea += DELIMITADOR;
+            linea += csv_quote(titulo_libro);
+            linea += DELIMITADOR;
+            linea += p.fecha_cierre;
+            linea += '\n';
+        }
+        return segmentos;
+    }
+
+    // Añade las líneas de cada periodo al final de su segmento y las fuerza a disco
+    // (se llama con mutex_disco tomado). Retorna false si algún segmento no se pudo escribir
+    bool anotar_en_archivo(const map<string, string>& segmentos) {
+        if (segmentos.empty()) {
+            return true;
+        }
+        bool ok = true;
+        error_code ec;
+        filesystem::create_directories(ARCHIVO_PRESTAMOS, ec);
+        for (const auto& par : segmentos) {
+            string ruta = ruta_segmento(par.first);
+            bool nuevo = !filesystem::exists(ruta, ec);
+            {
+                ofstream file(ruta, ios::app | ios::binary);
+                if (!file.is_open()) {
+                    cerr << "Error: No se pudo abrir " << ruta << " para escritura." << endl;
+                    ok = false;
+                    continue;
+                }
+                // Un segmento nuevo empieza con su cabecera
+                if (nuevo) {
+                    file << "id_prestamo,isbn,id_usuario,nombre_usuario,titulo,fecha_cierre\n";
+                }
+                file.write(par.second.data(), (streamsize)par.second.size());
+                file.close();
+                if (file.fail()) {
+                    cerr << "Error: No se pudo guardar " << ruta << endl;
+                    ok = false;
+                    continue;
+                }
+            }
+            if (!sincronizar_archivo(ruta, sync_archivo)) {
+                ok = false;
+            }
+            // El alta de un segmento también debe sobrevivir a un corte
+            if (nuevo) {
+                sincronizar_directorio(ruta);
+            }
+        }
+        return ok;
+    }
+
+    // --- Instantánea binaria (biblioteca.snap) ---
+    // Alternativa a los CSV como base de arranque: se proyecta en memoria y se decodifica
+    // registro a registro sin tokenizar texto. Los CSV siguen siendo el formato de
+    // importación/exportación.
+
+    // Contenido completo de la instantánea binaria (solo lee la memoria)
+    string serializarSnapshot() const {
+        // Acumulador de la tabla de cadenas y de las listas
+        EscritorSnapshot w;
+        // Registros fijos de cada sección
+        vector<RegLibro> regs_libros;
+        vector<RegUsuario> regs_usuarios;
+        vector<RegPrestamo> regs_prestamos;
+        vector<RegCola> regs_colas;
+        regs_libros.reserve(libros.size());
+        regs_usuarios.reserve(usuarios.size());
+        regs_prestamos.reserve(prestamos.size());
+
+        // Libros
+        for (const auto& par : libros) {
+            const Libro& b = par.second;
+            regs_libros.push_back({ w.cadena(b.isbn), w.cadena(b.titulo), w.cadena(b.genero), w.cadena(b.fecha_publi),
+                w.lista(b.autores), b.isbn_num, b.copias_totales, b.copias_disponibles });
+        }
+        // Usuarios
+        for (const auto& par : usuarios) {
+            const Usuario& u = par.second;
+            regs_usuarios.push_back({ w.cadena(u.id_usuario), w.cadena(u.nombre), w.cadena(u.correo),
+                w.lista(textos_de(u.prestamos_activos)), w.lista(textos_de(u.historial_isbn)), w.lista(u.historial_titulos),
+                u.num_prestamos_activos, 0 });
+        }
+        // Préstamos
+        for (const auto& par : prestamos) {
+            const Prestamo& p = par.second;
+            regs_prestamos.push_back({ w.cadena(p.id_prestamo), w.cadena(p.titulo), w.cadena(p.isbn.texto()),
+                w.cadena(p.id_usuario.texto()), p.activo ? 1u : 0u, 0 });
+        }
+        // Colas de espera (se copian porque std::queue no es iterable)
+        for (const auto& par : lista_espera) {
+            queue<uint32_t> q = par.second;
+            vector<string> ids;
+            while (!q.empty()) {
+                ids.push_back(ids_usuario.nombre(q.front()).texto());
+                q.pop();
+            }
+            if (!ids.empty()) {
+                regs_colas.push_back({ w.cadena(isbns.nombre(par.first).texto()), w.lista(ids) });
+            }
+        }
+
+        // Las referencias son de 32 bits: la tabla de cadenas no puede superar 4 GiB
+        if (w.cadenas.size() > UINT32_MAX || w.listas.size() > UINT32_MAX) {
+            cerr << "Error: datos demasiado grandes para " << SNAPSHOT_BIN << endl;
+            return string();
+        }
+
+        // Cabecera con conteos y posiciones de cada sección (en el orden del formato)
+        CabeceraSnapshot cab{};
+        memcpy(cab.magia, "BIBSNAP", 8);
+        cab.version = SNAPSHOT_VERSION;
+        cab.marca_endian = SNAPSHOT_MARCA_ENDIAN;
+        cab.num_libros = regs_libros.size();
+        cab.num_usuarios = regs_usuarios.size();
+        cab.num_prestamos = regs_prestamos.size();
+        cab.num_colas = regs_colas.size();
+        cab.num_listas = w.listas.size();
+        cab.tam_cadenas = w.cadenas.size();
+        cab.off_libros = sizeof(CabeceraSnapshot);
+        cab.off_usuarios = cab.off_libros + cab.num_libros * sizeof(RegLibro);
+        cab.off_prestamos = cab.off_usuarios + cab.num_usuarios * sizeof(RegUsuario);
+        cab.off_colas = cab.off_prestamos + cab.num_prestamos * sizeof(RegPrestamo);
+        cab.off_listas = cab.off_colas + cab.num_colas * sizeof(RegCola);
+        cab.off_cadenas = cab.off_listas + cab.num_listas * sizeof(RefCadena);
+
+        // Concatena todas las secciones de forma contigua
+        string out;
+        out.reserve(cab.off_cadenas + w.cadenas.size());
+        out.append(reinterpret_cast<const char*>(&cab), sizeof(cab));
+        out.append(reinterpret_cast<const char*>(regs_libros.data()), regs_libros.size() * sizeof(RegLibro));
+        out.append(reinterpret_cast<const char*>(regs_usuarios.data()), regs_usuarios.size() * sizeof(RegUsuario));
+        out.append(reinterpret_cast<const char*>(regs_prestamos.data()), regs_prestamos.size() * sizeof(RegPrestamo));
+        out.append(reinterpret_cast<const char*>(regs_colas.data()), regs_colas.size() * sizeof(RegCola));
+        out.append(reinterpret_cast<const char*>(w.listas.data()), w.listas.size() * sizeof(RefCadena));
+        out.append(w.cadenas.data(), w.cadenas.size());
+        return out;
+    }
+
+    // Carga el estado completo desde la instantánea binaria; retorna false si no existe o no es válida
+    bool cargarSnapshot() {
+        // Proyecta y valida el archivo
+        LectorSnapshot r;
+        if (!r.abrir(SNAPSHOT_BIN)) {
+            return false;
+        }
+        const CabeceraSnapshot& cab = r.cab;
+        size_t hilos = hilos_de_carga();
+        TablaLeida<Libro> t_libros;
+        TablaLeida<Usuario> t_usuarios;
+        TablaLeida<Prestamo> t_prestamos;
+        TablaLeida<pair<string, queue<string>>> t_colas;
+
+        // Los registros se decodifican por tramos en paralelo, igual que las filas de los CSV
+        vector<function<void()>> tareas;
+        // Libros
+        preparar_tramos_snapshot(t_libros, cab.num_libros, hilos, tareas, [&r](uint64_t i, TramoLeido<Libro>& tramo) {
+            RegLibro reg = r.registro<RegLibro>(r.cab.off_libros, i);
+            Libro l;
+            l.isbn = r.cadena(reg.isbn);
+            l.titulo = r.cadena(reg.titulo);
+            l.genero = r.cadena(reg.genero);
+            l.fecha_publi = r.cadena(reg.fecha_publi);
+            r.lista(reg.autores, [&](string s) { l.autores.push_back(std::move(s)); });
+            l.isbn_num = reg.isbn_num;
+            l.copias_totales = reg.copias_totales;
+            l.copias_disponibles = reg.copias_disponibles;
+            tramo.filas.push_back(std::move(l));
+        });
+        // Usuarios
+        preparar_tramos_snapshot(t_usuarios, cab.num_usuarios, hilos, tareas, [&r](uint64_t i, TramoLeido<Usuario>& tramo) {
+            RegUsuario reg = r.registro<RegUsuario>(r.cab.off_usuarios, i);
+            Usuario u;
+            u.id_usuario = r.cadena(reg.id_usuario);
+            u.nombre = r.cadena(reg.nombre);
+            u.correo = r.cadena(reg.correo);
+            r.lista(reg.prestamos_activos, [&](string s) { u.agregar_activo(ClaveIsbn::de(s)); });
+            r.lista(reg.historial_isbn, [&](string s) { u.historial_isbn.push_back(ClaveIsbn::de(s)); });
+            r.lista(reg.historial_titulos, [&](string s) { u.historial_titulos.push_back(std::move(s)); });
+            u.num_prestamos_activos = reg.num_prestamos_activos;
+            tramo.filas.push_back(std::move(u));
+        });
+        // Préstamos (instantáneas anteriores al archivo pueden traer préstamos cerrados)
+        preparar_tramos_snapshot(t_prestamos, cab.num_prestamos, hilos, tareas, [&r](uint64_t i, TramoLeido<Prestamo>& tramo) {
+            RegPrestamo reg = r.registro<RegPrestamo>(r.cab.off_prestamos, i);
+            Prestamo p;
+            p.id_prestamo = r.cadena(reg.id_prestamo);
+            p.titulo = r.cadena(reg.titulo);
+            p.isbn = ClaveIsbn::de(r.cadena(reg.isbn));
+            p.id_usuario = ClaveUsuario::de(r.cadena(reg.id_usuario));
+            p.activo = reg.activo != 0;
+            tramo.filas.push_back(std::move(p));
+        });
+        // Colas de espera
+        preparar_tramos_snapshot(t_colas, cab.num_colas, hilos, tareas, [&r](uint64_t i, TramoLeido<pair<string, queue<string>>>& tramo) {
+            RegCola reg = r.registro<RegCola>(r.cab.off_colas, i);
+            queue<string> q;
+            r.lista(reg.usuarios, [&](string s) { q.push(std::move(s)); });
+            tramo.filas.emplace_back(r.cadena(reg.isbn), std::move(q));
+        });
+        ejecutar_en_paralelo(tareas, hilos);
+
+        // Fusión en bloque, con los mapas reservados según los conteos de la cabecera
+        fusionar_tablas(t_libros, t_usuarios, t_prestamos, t_colas, hilos);
+
+        cout << "Datos cargados desde " << SNAPSHOT_BIN << " (version " << cab.version << ")" << endl;
+        return true;
+    }
+
+    // Indica si la bitácora actual se escribió sobre la instantánea binaria (primera línea "BASE,snapshot")
+    bool bitacora_sobre_snapshot() const {
+        ifstream file(BITACORA_CSV);
+        string line;
+        return file.is_open() && getline(file, line) && line == "BASE,snapshot";
+    }
+
+    // --- Bitácora de operaciones (journal) ---
+    // Cada mutación añade una sola línea a bitacora.csv en lugar de reescribir los CSV completos.
+    // Al iniciar, el constructor carga los CSV (última instantánea completa) y reproduce
+    // la bitácora encima. Los CSV solo se reescriben al compactar.
+    //
+    // La escritura la hace un hilo aparte: cada operación pública actualiza la memoria
+    // bajo 'mutex_estado' y entrega su registro (inmutable) a una cola acotada; el hilo
+    // escritor los anota por lotes, aplica la durabilidad y las políticas de volcado y
+    // compacta. El escritor nunca modifica la memoria: solo la lee (bajo 'mutex_estado')
+    // para serializar las tablas, y hace la E/S ya sin el candado.
+
+    // Lugar reservado en la cola de escritura por una operación; se devuelve al terminar
+    // la operación (haya encolado su registro o no), después de soltar 'mutex_estado'.
+    // Con durabilidad por operación, ahí mismo espera el fsync del registro que encoló
+    struct ReservaEscritura {
+        Biblioteca* biblioteca;
+        bool reservada;
+        // Último registro del hilo al reservar: si cambió, la operación encoló uno
+        uint64_t registro_previo;
+        ReservaEscritura(Biblioteca* b, bool r) : biblioteca(b), reservada(r), registro_previo(ultimo_registro_hilo) {}
+        ReservaEscritura(const ReservaEscritura&) = delete;
+        ReservaEscritura& operator=(const ReservaEscritura&) = delete;
+        explicit operator bool() const { return reservada; }
+        ~ReservaEscritura() {
+            if (reservada) {
+                biblioteca->liberar_reserva(ultimo_registro_hilo != registro_previo ? ultimo_registro_hilo : 0);
+            }
+        }
+    };
+
+    // Espera lugar en la cola de escritura antes de una operación (sin tener 'mutex_estado')
+    // Con la política de rechazo la reserva sale vacía si la cola está llena: la operación no
+    // debe aplicarse. El lugar se cuenta hasta que la operación termina, así que los registros
+    // encolados más los reservados nunca superan la capacidad
+    ReservaEscritura reservar_escritura() {
+        unique_lock<mutex> lk(mutex_cola);
+        ultima_rechazada = false;
+        auto hay_lugar = [&] { return cola_escritura.size() + reservados < capacidad_cola; };
+        if (!hay_lugar()) {
+            if (politica_cola == COLA_LLENA_RECHAZAR) {
+                metricas.rechazos++;
+                ultima_rechazada = true;
+                return ReservaEscritura(this, false);
+            }
+            metricas.esperas++;
+            cv_productor.wait(lk, hay_lugar);
+        }
+        reservados++;
+        return ReservaEscritura(this, true);
+    }
+
+    // Devuelve el lugar de una reserva (su registro, si lo hubo, ya ocupa uno en la cola)
+    // 'registro' es el número del registro encolado (0 si no hubo); con durabilidad por
+    // operación no se retorna hasta que llegó a disco
+    void liberar_reserva(uint64_t registro) {
+        unique_lock<mutex> lk(mutex_cola);
+        reservados--;
+        cv_productor.notify_one();
+        if (registro != 0 && durabilidad == DURABILIDAD_OPERACION) {
+            cv_sincronizado.wait(lk, [&] { return registros_sincronizados >= registro; });
+        }
+    }
+
+    // Entrega un registro (tipo y campos) al hilo escritor
+    // Se llama con 'mutex_estado' tomado y con una reserva en curso, así que no bloquea
+    void anotar_bitacora(vector<string> campos) {
+        {
+            lock_guard<mutex> lk(mutex_cola);
+            ultimo_registro_hilo = ++registros_encolados;
+            cola_escritura.push_back({ std::move(campos), chrono::steady_clock::now(), ultimo_registro_hilo });
+            metricas.profundidad_maxima = max(metricas.profundidad_maxima, cola_escritura.size());
+        }
+        cv_escritor.notify_one();
+    }
+
+    // Bucle del hilo escritor: toma los registros pendientes de a lotes y los anota; además
+    // despierta cuando vence el plazo de la durabilidad por grupo o de la política de volcado.
+    // Al cerrar termina de anotar todo lo encolado antes de salir.
+    void bucle_escritor() {
+        unique_lock<mutex> lk(mutex_cola);
+        while (true) {
+            auto hay_trabajo = [&] { return !cola_escritura.empty() || cerrando; };
+            chrono::steady_clock::time_point plazo;
+            if (proximo_plazo(plazo)) {
+                cv_escritor.wait_until(lk, plazo, hay_trabajo);
+            }
+            else {
+                cv_escritor.wait(lk, hay_trabajo);
+            }
+            // Todo lo pendiente forma un lote
+            vector<RegistroPendiente> lote(make_move_iterator(cola_escritura.begin()),
+                                           make_move_iterator(cola_escritura.end()));
+            cola_escritura.clear();
+            cv_productor.notify_all();
+            lk.unlock();
+            
+            if (!lote.empty()) {
+                registros_tomados = lote.back().numero;
+            }
+            escribir_lote(lote);
+            // Plazos vencidos o límites de mutaciones alcanzados
+            volcar_si_corresponde();
+            sincronizar_bitacora(false);
+            
+            lk.lock();
+            // Sin nada pendiente de fsync, todo lo tomado ya está en disco
+            if (!bitacora_sin_sync && registros_sincronizados < registros_tomados) {
+                registros_sincronizados = registros_tomados;
+                cv_sincronizado.notify_all();
+            }
+            if (cerrando && cola_escritura.empty()) {
+                break;
+            }
+        }
+    }
+
+    // Próximo momento en que el escritor tiene algo que hacer sin registros nuevos
+    // (fsync por grupo o volcado por tiempo); retorna false si no hay ninguno pendiente
+    bool proximo_plazo(chrono::steady_clock::time_point& plazo) const {
+        bool hay = false;
+        if (bitacora_sin_sync && durabilidad == DURABILIDAD_GRUPO) {
+            plazo = ultimo_sync_bitacora + chrono::milliseconds(ms_grupo);
+            hay = true;
+        }
+        for (const EstadoTabla& e : tablas) {
+            if (e.sucia) {
+                auto vence = e.primera_mutacion + chrono::milliseconds(e.politica.max_ms);
+                plazo = hay ? min(plazo, vence) : vence;
+                hay = true;
+            }
+        }
+        return hay;
+    }
+
+    // Anota un lote de registros en la bitácora (hilo escritor)
+    void escribir_lote(const vector<RegistroPendiente>& lote) {
+        if (lote.empty()) {
+            return;
+        }
+        anotar_registros(lote);
+        // Marca como sucias las tablas que toca cada operación
+        for (const RegistroPendiente& r : lote) {
+            marcar_sucias(r.campos[0]);
+        }
+        // Lo fuerza a disco si el nivel de durabilidad lo pide
+        sincronizar_bitacora(false);
+        registrar_retraso(lote);
+    }
+
+    // Escribe los registros al final de la bitácora y los entrega al sistema operativo
+    void anotar_registros(const vector<RegistroPendiente>& lote) {
+        // Abre la bitácora en modo append la primera vez que se necesita
+        if (!bitacora.is_open()) {
+            bitacora.open(BITACORA_CSV, ios::app);
+        }
+        for (const RegistroPendiente& r : lote) {
+            // Escribe cada campo entrecomillado si hace falta, separado por comas
+            for (size_t i = 0; i < r.campos.size(); ++i) {
+                if (i) {
+                    bitacora << DELIMITADOR;
+                }
+                bitacora << csv_quote(r.campos[i]);
+            }
+            bitacora << "\n";
+        }
+        // El lote completo se entrega al sistema operativo de una vez
+        bitacora.flush();
+        bitacora_sin_sync = true;
+    }
+
+    // Actualiza las métricas con registros que ya llegaron a la bitácora (o a una base)
+    void registrar_retraso(const vector<RegistroPendiente>& lote) {
+        if (lote.empty()) {
+            return;
+        }
+        auto ahora = chrono::steady_clock::now();
+        lock_guard<mutex> lk(mutex_cola);
+        for (const RegistroPendiente& r : lote) {
+            double ms = chrono::duration<double, milli>(ahora - r.encolado).count();
+            metricas.retraso_ultimo_ms = ms;
+            metricas.retraso_maximo_ms = max(metricas.retraso_maximo_ms, ms);
+            metricas.retraso_total_ms += ms;
+        }
+        metricas.registros_escritos += lote.size();
+        metricas.lotes++;
+    }
+
+    // Fuerza la bitácora a disco según el nivel de durabilidad
+    // En modo GRUPO solo sincroniza si pasó el plazo desde el último fsync, salvo con 'forzar'
+    // (el hilo escritor despierta al vencer el plazo para sincronizar lo que quedó esperando)
+    void sincronizar_bitacora(bool forzar) {
+        if (!bitacora_sin_sync || durabilidad == DURABILIDAD_NINGUNA) {
+            return;
+        }
+        auto ahora = chrono::steady_clock::now();
+        if (durabilidad == DURABILIDAD_GRUPO && !forzar
+            && chrono::duration_cast<chrono::milliseconds>(ahora - ultimo_sync_bitacora).count() < ms_grupo) {
+            return;
+        }
+        sincronizar_archivo(BITACORA_CSV, sync_bitacora);
+        bitacora_sin_sync = false;
+        ultimo_sync_bitacora = ahora;
+    }
+
+    // Marca como sucias las tablas afectadas por un tipo de registro de la bitácora
+    void marcar_sucias(string_view tipo) {
+        // Tablas afectadas según la operación
+        vector<Tabla> afectadas;
+        if (tipo == "LIBRO_ALTA" || tipo == "LIBRO_RETIRO") {
+            afectadas = { TABLA_LIBROS };
+        }
+        else if (tipo == "LIBRO_MOD" || tipo == "LIBRO_BAJA" || tipo == "USUARIO_BAJA"
+            || tipo == "PRESTAMO" || tipo == "PRESTAMO_ANULADO") {
+            // Cascadas sobre préstamos e historiales (y stock en bajas y préstamos)
+            afectadas = { TABLA_LIBROS, TABLA_USUARIOS, TABLA_PRESTAMOS };
+        }
+        else if (tipo == "USUARIO_ALTA" || tipo == "USUARIO_RETIRO") {
+            afectadas = { TABLA_USUARIOS };
+        }
+        else if (tipo == "DEVOLUCION") {
+            // La devolución puede además sacar a alguien de la lista de espera
+            afectadas = { TABLA_LIBROS, TABLA_USUARIOS, TABLA_PRESTAMOS, TABLA_LISTA_ESPERA };
+        }
+        else if (tipo == "COLA" || tipo == "COLA_RETIRO") {
+            afectadas = { TABLA_LISTA_ESPERA };
+        }
+        
+        // Actualiza bandera, contador y marca de tiempo de cada tabla
+        for (Tabla t : afectadas) {
+            marcar_tabla_sucia(t);
+        }
+    }
+
+    // Cuenta una mutación pendiente de volcar en la tabla 't'
+    void marcar_tabla_sucia(Tabla t) {
+        EstadoTabla& e = tablas[t];
+        // La primera mutación pendiente arranca el reloj de la política
+        if (!e.sucia) {
+            e.sucia = true;
+            e.primera_mutacion = chrono::steady_clock::now();
+        }
+        e.mutaciones++;
+    }
+
+    // Vuelca las tablas sucias si alguna superó su límite de mutaciones o de tiempo
+    void volcar_si_corresponde() {
+        // Momento actual para comparar con la primera mutación pendiente
+        auto ahora = chrono::steady_clock::now();
+        for (const EstadoTabla& e : tablas) {
+            // Tablas limpias no disparan nada
+            if (!e.sucia) {
+                continue;
+            }
+            // Milisegundos transcurridos desde la primera mutación pendiente
+            long long ms = chrono::duration_cast<chrono::milliseconds>(ahora - e.primera_mutacion).count();
+            if (e.mutaciones >= e.politica.max_mutaciones || ms >= e.politica.max_ms) {
+                compactarBitacora();
+                return;
+            }
+        }
+    }
+
+    // Reescribe los CSV de las tablas sucias y vacía la bitácora
+    // Se vuelcan todas las sucias juntas: la bitácora solo puede truncarse cuando
+    // ningún CSV depende ya de ella
+    void compactarBitacora() {
+        // El disco se toma primero: una consulta al archivo no puede ver los préstamos cerrados
+        // fuera de la memoria y todavía sin anotar
+        lock_guard<mutex> lk_disco(mutex_disco);
+        // Contenidos a escribir: se serializan con la memoria detenida y se escriben sin el candado
+        vector<pair<Tabla, string>> csv;
+        string snapshot;
+        map<string, string> segmentos;
+        // Registros retirados de la cola y préstamos cerrados que salen de la memoria: si la
+        // compactación falla, vuelven a la bitácora y a la memoria
+        vector<RegistroPendiente> incluidos;
+        vector<Prestamo> cerrados;
+        {
+            lock_guard<mutex> lk_estado(mutex_estado);
+            // Los registros que siguen en la cola ya están aplicados en memoria: quedan
+            // incluidos en esta base, así que se retiran sin anotarlos en la bitácora
+            {
+                lock_guard<mutex> lk_cola(mutex_cola);
+                incluidos.assign(make_move_iterator(cola_escritura.begin()), make_move_iterator(cola_escritura.end()));
+                cola_escritura.clear();
+            }
+            if (!incluidos.empty()) {
+                registros_tomados = incluidos.back().numero;
+            }
+            cv_productor.notify_all();
+            for (const RegistroPendiente& r : incluidos) {
+                marcar_sucias(r.campos[0]);
+            }
+            registrar_retraso(incluidos);
+            
+            // Los préstamos cerrados salen de la memoria hacia su segmento del archivo
+            segmentos = serializarCerrados();
+            cerrados = std::move(prestamos_cerrados);
+            prestamos_cerrados.clear();
+            
+            // Si más de la mitad de los textos del catálogo quedó sin usar (títulos y autores
+            // reemplazados por otros más largos), se rearman
+            if (catalogo.textos_sin_usar > catalogo.textos.size() / 2) {
+                catalogo.compactar_textos();
+            }
+            
+            // En modo instantánea se reescribe solo biblioteca.snap; los CSV se exportan al salir
+            if (modo_snapshot) {
+                snapshot = serializarSnapshot();
+            }
+            else {
+                for (int t = 0; t < NUM_TABLAS; ++t) {
+                    if (tablas[t].sucia) {
+                        csv.emplace_back((Tabla)t, serializarTabla((Tabla)t));
+                    }
+                }
+            }
+        }
+        
+        // Primero el archivo: si se corta antes de reescribir las bases, la bitácora vuelve a
+        // cerrar esos préstamos y el archivo queda con líneas repetidas (las consultas las descartan)
+        bool ok = anotar_en_archivo(segmentos);
+        if (!ok) {
+            // Los cerrados vuelven a la memoria (delante de los que se cerraron mientras tanto)
+            // para anotarse en la próxima compactación
+            lock_guard<mutex> lk_estado(mutex_estado);
+            prestamos_cerrados.insert(prestamos_cerrados.begin(), cerrados.begin(), cerrados.end());
+        }
+        // Las bases nuevas y la bitácora vacía se reemplazan juntas
+        if (ok) {
+            vector<BaseNueva> bases;
+            if (modo_snapshot) {
+                // Sin instantánea (datos demasiado grandes) no hay nada que reemplazar
+                ok = !snapshot.empty();
+                bases.push_back({ SNAPSHOT_BIN, &snapshot, &sync_snapshot, ios::binary });
+            }
+            for (const auto& par : csv) {
+                bases.push_back({ ruta_tabla(par.first), &par.second, &sync_tablas[par.first], ios::out });
+            }
+            // Mientras los CSV estén atrasados, la bitácora declara que su base es la instantánea
+            ok = ok && reemplazar_bases(bases, modo_snapshot ? "BASE,snapshot" : "");
+            if (ok && modo_snapshot) {
+                csv_desactualizados = true;
+            }
+        }
+        
+        // Si algo falló, la bitácora se conserva y las tablas siguen sucias: los registros
+        // retirados de la cola no llegaron a ninguna base y se anotan en ella. El reloj de
+        // la política vuelve a empezar para reintentar tras su plazo y no en cada lote
+        if (!ok) {
+            cerr << "Error: No se pudo compactar la bitacora; se conserva y se reintentara." << endl;
+            anotar_registros(incluidos);
+            sincronizar_bitacora(false);
+            for (EstadoTabla& e : tablas) {
+                if (e.sucia) {
+                    e.primera_mutacion = chrono::steady_clock::now();
+                    e.mutaciones = 0;
+                }
+            }
+            return;
+        }
+        
+        // Todas las tablas quedan limpias
+        for (EstadoTabla& e : tablas) {
+            e.sucia = false;
+            e.mutaciones = 0;
+        }
+    }
+
+    // Exporta las cuatro tablas a CSV y vacía la bitácora (todas las bases quedan al día)
+    // Solo se usa al cerrar, con el hilo escritor ya detenido
+    void exportarCSV() {
+        vector<string> contenidos;
+        for (int t = 0; t < NUM_TABLAS; ++t) {
+            contenidos.push_back(serializarTabla((Tabla)t));
+        }
+        vector<BaseNueva> bases;
+        for (int t = 0; t < NUM_TABLAS; ++t) {
+            bases.push_back({ ruta_tabla((Tabla)t), &contenidos[t], &sync_tablas[t], ios::out });
+        }
+        if (reemplazar_bases(bases, "")) {
+            csv_desactualizados = false;
+        }
+    }
+
+    // Base a reemplazar: destino, contenido completo y contador de sus fsync
+    struct BaseNueva {
+        string ruta;
+        const string* contenido;
+        ContadorSync* contador;
+        ios::openmode modo;
+    };
+
+    // Reemplaza a la vez varias bases y vacía la bitácora (dejando 'cabecera' como su primera
+    // línea, si no es vacía). Las bases se escriben y fuerzan a disco como temporales; luego una
+    // marca atómica decide el reemplazo y recién entonces se renombran. Si el programa cae a
+    // mitad, el arranque lo termina: nunca quedan bases nuevas bajo una bitácora vieja, que
+    // reaplicaría operaciones ya incluidas. Retorna false si el reemplazo no llegó a decidirse
+    // (las bases y la bitácora quedan como estaban). Solo el hilo escritor (o el cierre) la usa
+    bool reemplazar_bases(const vector<BaseNueva>& bases, const string& cabecera) {
+        // Un reemplazo anterior que no pudo terminar se termina primero
+        if (!completar_reemplazo()) {
+            return false;
+        }
+        // 1. Cada base va a su temporal, forzado a disco (deque: las escrituras no se mueven)
+        deque<EscrituraAtomica> salidas;
+        for (const BaseNueva& b : bases) {
+            salidas.emplace_back(b.ruta, b.modo);
+            EscrituraAtomica& salida = salidas.back();
+            if (!salida.file.is_open()) {
+                cerr << "Error: No se pudo abrir " << b.ruta << " para escritura." << endl;
+                return false;
+            }
+            salida.file.write(b.contenido->data(), (streamsize)b.contenido->size());
+            if (!salida.preparar(*b.contador)) {
+                cerr << "Error: No se pudo guardar " << b.ruta << endl;
+                return false;
+            }
+        }
+        
+        // 2. La marca: cabecera de la bitácora nueva, cuánto de la bitácora actual ya está
+        // incluido en las bases y los destinos. Desde que llega a disco, el reemplazo está decidido
+        if (bitacora.is_open()) {
+            bitacora.flush();
+        }
+        error_code ec;
+        uintmax_t incluido = filesystem::file_size(BITACORA_CSV, ec);
+        if (ec) {
+            incluido = 0;
+        }
+        string marca = cabecera + "\n" + to_string(incluido) + "\n";
+        for (const BaseNueva& b : bases) {
+            marca += b.ruta + "\n";
+        }
+        if (!escribir_archivo(COMPACTACION_PENDIENTE, marca, sync_bitacora)) {
+            return false;
+        }
+        // Los temporales ya pertenecen a la marca: no se borran al salir de aquí
+        for (EscrituraAtomica& salida : salidas) {
+            salida.confirmada = true;
+        }
+        
+        // 3. Renombrado y bitácora nueva (lo mismo que haría el arranque tras un corte)
+        if (!completar_reemplazo()) {
+            cerr << "Error: No se pudo terminar la compactacion; se terminara en el proximo intento." << endl;
+        }
+        return true;
+    }
+
+    // Termina el reemplazo de bases decidido en COMPACTACION_PENDIENTE, si lo hay. La marca pasa
+    // por dos fases: con el largo incluido de la bitácora, renombra las bases y prepara la
+    // bitácora nueva (cabecera + lo anotado después de la marca); con "-", ya solo quedan
+    // temporales por renombrar. Cada paso se puede repetir tras otro corte
+    bool completar_reemplazo() {
+        ifstream file(COMPACTACION_PENDIENTE, ios::binary);
+        if (!file.is_open()) {
+            return true;
+        }
+        string cabecera, incluido, ruta;
+        getline(file, cabecera);
+        getline(file, incluido);
+        vector<string> rutas;
+        while (getline(file, ruta)) {
+            if (!ruta.empty()) {
+                rutas.push_back(ruta);
+            }
+        }
+        file.close();
+        
+        // Renombra los temporales que sigan ahí (los ya renombrados no existen)
+        auto renombrar = [&]() {
+            for (const string& destino : rutas) {
+                string temporal = destino + ".tmp";
+                error_code ec;
+                if (!filesystem::exists(temporal, ec)) {
+                    continue;
+                }
+                filesystem::rename(temporal, destino, ec);
+                if (ec) {
+                    cerr << "Error: No se pudo renombrar " << temporal << endl;
+                    return false;
+                }
+            }
+            if (!rutas.empty()) {
+                sincronizar_directorio(rutas[0]);
+            }
+            return true;
+        };
+        if (!renombrar()) {
+            return false;
+        }
+        
+        // Primera fase: la bitácora nueva se prepara como temporal y la marca pasa a la segunda
+        if (incluido != "-") {
+            size_t desde = 0;
+            if (!convertir_numero(incluido, desde)) {
+                cerr << "Error: Marca de compactacion invalida en " << COMPACTACION_PENDIENTE << endl;
+                return false;
+            }
+            // Lo anotado después de decidir el reemplazo no está en las bases y se conserva
+            string contenido = cabecera.empty() ? string() : cabecera + "\n";
+            if (bitacora.is_open()) {
+                bitacora.flush();
+            }
+            ifstream anterior(BITACORA_CSV, ios::binary);
+            if (anterior.is_open()) {
+                anterior.seekg(0, ios::end);
+                streamoff largo = anterior.tellg();
+                if (largo > (streamoff)desde) {
+                    string resto((size_t)(largo - (streamoff)desde), '\0');
+                    anterior.seekg((streamoff)desde);
+                    anterior.read(&resto[0], (streamsize)resto.size());
+                    contenido += resto;
+                }
+            }
+            EscrituraAtomica nueva(BITACORA_CSV);
+            if (!nueva.file.is_open()) {
+                return false;
+            }
+            nueva.file.write(contenido.data(), (streamsize)contenido.size());
+            if (!nueva.preparar(sync_bitacora)) {
+                return false;
+            }
+            rutas = { BITACORA_CSV };
+            if (!escribir_archivo(COMPACTACION_PENDIENTE, cabecera + "\n-\n" + BITACORA_CSV + "\n", sync_bitacora)) {
+                return false;
+            }
+            nueva.confirmada = true;
+        }
+        
+        // Segunda fase: la bitácora nueva reemplaza a la vieja y la marca se borra
+        if (bitacora.is_open()) {
+            bitacora.close();
+        }
+        if (!renombrar()) {
+            return false;
+        }
+        error_code ec;
+        filesystem::remove(COMPACTACION_PENDIENTE, ec);
+        if (ec) {
+            return false;
+        }
+        sincronizar_directorio(COMPACTACION_PENDIENTE);
+        bitacora_sin_sync = false;
+        ultimo_sync_bitacora = chrono::steady_clock::now();
+        return true;
+    }
+
+    // Indica si alguna tabla tiene cambios sin volcar
+    bool hay_tablas_sucias() const {
+        for (const EstadoTabla& e : tablas) {
+            if (e.sucia) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Reproduce la bitácora sobre los datos cargados desde los CSV
+    void reproducirBitacora() {
+        // Si no existe bitácora, no hay operaciones pendientes
+        LectorCSV lector;
+        if (!lector.abrir(BITACORA_CSV, DELIMITADOR)) {
+            return;
+        }
+        
+        // Campos de cada registro (vistas sobre el buffer)
+        vector<string_view> c;
+        // Contador de operaciones reproducidas
+        size_t aplicados = 0;
+        
+        // Lee registro por registro
+        while (lector.siguiente_fila(c)) {
+            // Un último registro sin salto de línea es una escritura interrumpida: se descarta
+            if (!lector.fila_completa) {
+                break;
+            }
+            // El primer campo indica el tipo de operación
+            string_view tipo = c[0];
+            
+            // Despacha cada tipo a su función de aplicación (sin deshacer, sin mensajes)
+            if (tipo == "LIBRO_ALTA" && c.size() >= 8) {
+                Libro l;
+                if (libro_desde_campos(c, 1, l)) {
+                    aplicarAltaLibro(l);
+                }
+            }
+            else if (tipo == "LIBRO_MOD" && c.size() >= 9) {
+                Libro l;
+                if (libro_desde_campos(c, 2, l)) {
+                    aplicarModificacionLibro(string(c[1]), l);
+                }
+            }
+            else if (tipo == "LIBRO_BAJA" && c.size() >= 2) {
+                aplicarBajaLibro(string(c[1]));
+            }
+            else if (tipo == "LIBRO_RETIRO" && c.size() >= 2) {
+                aplicarRetiroLibro(string(c[1]));
+            }
+            else if (tipo == "USUARIO_ALTA" && c.size() >= 4) {
+                Usuario u;
+                u.id_usuario = string(c[1]);
+                u.nombre = string(c[2]);
+                u.correo = string(c[3]);
+                aplicarAltaUsuario(u);
+            }
+            else if (tipo == "USUARIO_BAJA" && c.size() >= 2) {
+                aplicarBajaUsuario(string(c[1]));
+            }
+            else if (tipo == "USUARIO_RETIRO" && c.size() >= 2) {
+                aplicarRetiroUsuario(string(c[1]));
+            }
+            else if (tipo == "PRESTAMO" && c.size() >= 4) {
+                aplicarPrestamo(string(c[1]), string(c[2]), string(c[3]));
+            }
+            else if (tipo == "PRESTAMO_ANULADO" && c.size() >= 2) {
+                aplicarAnulacionPrestamo(string(c[1]));
+            }
+            else if (tipo == "DEVOLUCION" && c.size() >= 5) {
+                // La fecha de cierre (sexto campo) falta en bitácoras anteriores al archivo
+                string fecha = c.size() >= 6 ? string(c[5]) : "";
+                aplicarDevolucion(string(c[1]), string(c[2]), string(c[3]), string(c[4]), fecha);
+            }
+            else if (tipo == "COLA" && c.size() >= 3) {
+                aplicarEnCola(string(c[1]), string(c[2]));
+            }
+            else if (tipo == "COLA_RETIRO" && c.size() >= 3) {
+                aplicarSalidaCola(string(c[1]), string(c[2]));
+            }
+            else {
+                // Registro desconocido o incompleto: se ignora
+                continue;
+            }
+            // Las tablas afectadas siguen pendientes de volcar a su CSV
+            marcar_sucias(tipo);
+            aplicados++;
+        }
+        // Informa cuántas operaciones se reprodujeron
+        if (aplicados) {
+            cout << "Bitacora reproducida: " << aplicados << " operaciones desde " << BITACORA_CSV << endl;
+        }
+    }
+
+    // --- Aplicación de operaciones sobre la memoria ---
+    // Estas funciones solo modifican las estructuras en memoria: no validan, no imprimen,
+    // no registran acciones de deshacer ni escriben a disco. Las usan tanto las operaciones
+    // públicas como la reproducción de la bitácora.
+
+    // Inserta un libro en el mapa principal y en todos los índices
+    void aplicarAltaLibro(const Libro& libro) {
+        // Inserta el libro en el mapa principal (y le da número si es nuevo)
+        libros[libro.isbn] = libro;
+        ClaveIsbn clave = ClaveIsbn::de(libro.isbn);
+        uint32_t n_libro = isbns.id(clave);
+        catalogo.poner(n_libro, clave, libro);
+        // Un historial que lo mencionaba como "no encontrado" ahora muestra su título
+        version_titulos++;
+        
+        // Actualiza el índice de búsqueda por título
+        indexar_titulo(libro.isbn, libro.titulo);
+        
+        // Indexa el título en el Trie y mapa de búsqueda para autocompletado
+        indexar_termino(libro.titulo, n_libro); 
+        
+        // Itera sobre cada autor para indexarlo también
+        for (const string& autor : libro.autores) {
+            indexar_termino(autor, n_libro); 
+        }
+        
+        // Si el libro tiene un ISBN numérico válido, lo inserta en el árbol AVL
+        if (libro.isbn_num != 0) {
+            isbn_avl.insertar(libro.isbn_num, libro.isbn);
+        }
+    }
+
+    // Quita un libro del árbol AVL (si tenía ISBN numérico)
+    void quitar_de_avl(const Libro& libro) {
+        if (libro.isbn_num != 0) {
+            isbn_avl.quitar(libro.isbn_num, libro.isbn);
+        }
+    }
+
+    // Elimina un libro y limpia en cascada préstamos, historiales e índice
+    void aplicarBajaLibro(const string& isbn) {
+        // Si el libro no existe no hay nada que limpiar
+        if (!libros.count(isbn)) {
+            return;
+        }
+
+        // Clave y número del libro (lo tiene desde su alta)
+        ClaveIsbn clave = ClaveIsbn::de(isbn);
+        uint32_t n_libro = isbns.id(clave);
+
+        // 1. Limpiar PRÉSTAMOS asociados a este libro (solo los de su lista inversa)
+        auto it_prestamos = prestamos_libro.find(n_libro);
+        if (it_prestamos != prestamos_libro.end()) {
+            // Se saca la lista antes: borrar_prestamo la modifica
+            unordered_set<string> prestamos_a_borrar = std::move(it_prestamos->second);
+            prestamos_libro.erase(it_prestamos);
+            for (const string& pid : prestamos_a_borrar) {
+                borrar_prestamo(pid);
+            }
+        }
+
+        // 2. Limpiar USUARIOS (Historiales y Préstamos Activos)
+        // Solo los que lo tienen o lo leyeron; el resto no puede cambiar
+        unordered_set<uint32_t> lectores;
+        auto it_lectores = lectores_libro.find(n_libro);
+        if (it_lectores != lectores_libro.end()) {
+            lectores = std::move(it_lectores->second);
+            lectores_libro.erase(it_lectores);
+        }
+        // Nota: Como estamos borrando el libro, necesitamos su título actual antes de que desaparezca
+        string titulo_a_borrar = libros[isbn].titulo;
+        for (uint32_t n_usuario : lectores) {
+            auto it_usuario = usuarios.find(ids_usuario.nombre(n_usuario).texto());
+            if (it_usuario == usuarios.end()) {
+                continue;
+            }
+            Usuario& u = it_usuario->second;
+
+            // A. Si el usuario lo tiene prestado actualmente, lo quitamos del set activo
+            if (u.quitar_activo(clave)) {
+                // Actualiza el contador de préstamos activos (evita negativos con max)
+                u.num_prestamos_activos = max(0, u.num_prestamos_activos - 1);
+                u.fila_csv.clear();
+            }
+
+            // B. Limpiar del historial de ISBNs (vector)
+            // Usa el idioma erase-remove: 'remove' mueve los elementos a borrar al final
+            // y devuelve el iterador al nuevo final lógico.
+            auto it_isbn = remove(u.historial_isbn.begin(), u.historial_isbn.end(), clave);
+            
+            // Si se encontraron elementos para borrar
+            if (it_isbn != u.historial_isbn.end()) {
+                // 'erase' elimina físicamente los elementos del vector
+                u.historial_isbn.erase(it_isbn, u.historial_isbn.end());
+                u.fila_csv.clear();
+            }
+
+            // C. Limpiar del historial de Títulos (vector de strings)
+            // Busca y elimina el título del historial de lectura del usuario
+            auto it_titulo = remove(u.historial_titulos.begin(), u.historial_titulos.end(), titulo_a_borrar);
+            
+            // Si se encontró, se borra
+            if (it_titulo != u.historial_titulos.end()) {
+                u.historial_titulos.erase(it_titulo, u.historial_titulos.end());
+                u.fila_csv.clear();
+            }
+        }
+
+        // 3. Eliminar del índice auxiliar (Titulo, ISBN)
+        desindexar_titulo(isbn);
+
+        // 4. Eliminar el libro del árbol AVL, de las columnas y del mapa principal
+        quitar_de_avl(libros[isbn]);
+        catalogo.quitar(n_libro);
+        // Sale de sus palabras de búsqueda (que bajan de puntaje, o salen del autocompletado si
+        // era su único libro)
+        desindexar_terminos(libros[isbn], n_libro);
+        libros.erase(isbn);
+    }
+
+    // Reemplaza los datos de un libro y propaga el cambio de título
+    void aplicarModificacionLibro(const string& isbn, const Libro& nuevo) {
+        // Si el libro original no existe no hay nada que modificar
+        if (!libros.count(isbn)) {
+            return;
+        }
+        
+        // Guarda una copia del libro viejo para comparar cambios
+        Libro viejo = libros[isbn];
+        string titulo_anterior = viejo.titulo;
+
+        // Actualiza el libro en el mapa principal y en las columnas con los datos nuevos
+        // (el ISBN no cambia, así que conserva su valor numérico y su nodo del AVL)
+        libros[isbn] = nuevo;
+        libros[isbn].isbn_num = viejo.isbn_num;
+        ClaveIsbn clave = ClaveIsbn::de(isbn);
+        catalogo.poner(isbns.id(clave), clave, nuevo);
+
+        // Actualiza el índice secundario (reemplaza la entrada antigua de este ISBN)
+        indexar_titulo(isbn, nuevo.titulo);
+        
+        // Re-indexa el nuevo título y autores para la búsqueda (el título o autor que ya no
+        // tiene deja de encontrarlo)
+        uint32_t n_nuevo = isbns.id(ClaveIsbn::de(nuevo.isbn));
+        desindexar_terminos(viejo, n_nuevo, &nuevo);
+        indexar_termino(nuevo.titulo, n_nuevo); 
+        for (const string& autor : nuevo.autores) {
+            indexar_termino(autor, n_nuevo); 
+        }
+
+        // --- CASCADA: Actualizar título en Usuarios y Préstamos si cambió ---
+        if (titulo_anterior != nuevo.titulo) {
+            // Número del libro (lo tiene desde su alta)
+            uint32_t n_libro = isbns.id(clave);
+
+            // 1. Actualizar Préstamos activos (que guardan una copia del título)
+            auto it_prestamos = prestamos_libro.find(n_libro);
+            if (it_prestamos != prestamos_libro.end()) {
+                for (const string& pid : it_prestamos->second) {
+                    auto it = prestamos.find(pid);
+                    if (it != prestamos.end()) {
+                        it->second.titulo = nuevo.titulo;
+                    }
+                }
+            }
+
+            // 2. Actualizar Historial de Usuarios (Aquí es texto plano, hay que buscar y reemplazar)
+            // Solo los lectores del libro pueden tener su título en el historial
+            auto it_lectores = lectores_libro.find(n_libro);
+            const unordered_set<uint32_t> ninguno;
+            for (uint32_t n_usuario : it_lectores != lectores_libro.end() ? it_lectores->second : ninguno) {
+                auto it_usuario = usuarios.find(ids_usuario.nombre(n_usuario).texto());
+                if (it_usuario == usuarios.end()) {
+                    continue;
+                }
+                Usuario& u = it_usuario->second;
+                // Itera por referencia sobre cada título en el historial
+                for (string& t : u.historial_titulos) {
+                    // Si coincide con el título viejo
+                    if (t == titulo_anterior) {
+                        // Lo reemplaza con el nuevo
+                        t = nuevo.titulo;
+                        u.fila_csv.clear();
+                    }
+                }
+                // Una línea que toma los títulos del catálogo también cambia si leyó este libro
+                if (fila_depende_de_libros(u) && find(u.historial_isbn.begin(), u.historial_isbn.end(), clave) != u.historial_isbn.end()) {
+                    u.fila_csv.clear();
+                }
+            }
+        }
+    }
+
+    // Revierte el alta de un libro (deshacer): lo quita del mapa y del índice, sin cascada
+    void aplicarRetiroLibro(const string& isbn) {
+        // Borrado manual rápido del mapa principal
+        // Nota: No usamos la baja completa para evitar efectos secundarios no deseados aquí
+        auto it_libro = libros.find(isbn);
+        if (it_libro == libros.end()) {
+            return;
+        }
+        quitar_de_avl(it_libro->second);
+        catalogo.quitar(isbns.buscar(ClaveIsbn::de(isbn)));
+        desindexar_terminos(it_libro->second, isbns.buscar(ClaveIsbn::de(isbn)));
+        libros.erase(it_libro);
+        // Los historiales que lo mencionan pasan a "no encontrado"
+        version_titulos++;
+        
+        // Borrar del índice (Título, ISBN)
+        desindexar_titulo(isbn);
+    }
+
+    // Pone al libro 'isbn' en el índice de títulos bajo 'titulo' (quitando su entrada anterior)
+    void indexar_titulo(const string& isbn, const string& titulo) {
+        auto it = titulo_indexado.find(isbn);
+        if (it != titulo_indexado.end()) {
+            indice.erase({ it->second, isbn });
+            it->second = titulo;
+        }
+        else {
+            titulo_indexado.emplace(isbn, titulo);
+        }
+        indice.emplace(titulo, isbn);
+    }
+
+    // Quita al libro 'isbn' del índice de títulos
+    void desindexar_titulo(const string& isbn) {
+        auto it = titulo_indexado.find(isbn);
+        if (it == titulo_indexado.end()) {
+            return;
+        }
+        indice.erase({ it->second, isbn });
+        titulo_indexado.erase(it);
+    }
+
+    // Inserta un usuario en el mapa principal
+    void aplicarAltaUsuario(const Usuario& u) {
+        usuarios[u.id_usuario] = u;
+        // Un usuario que llega con historial queda en las listas de lectores
+        indexar_lector(u);
+    }
+
+    // Elimina un usuario, devuelve su stock prestado y borra sus préstamos
+    void aplicarBajaUsuario(const string& uid) {
+        // Si el usuario no existe no hay nada que limpiar
+        if (!usuarios.count(uid)) {
+            return;
+        }
+
+        // Obtiene referencia al usuario
+        Usuario& u = usuarios[uid];
+
+        // 1. Devolver libros que el usuario tenga activos (Recuperar stock para la biblioteca)
+        // Itera sobre los ISBNs que tiene prestados actualmente
+        for (ClaveIsbn isbn : u.prestamos_activos) {
+            // Si el libro existe en la base de datos
+            auto it_libro = libros.find(isbn.texto());
+            if (it_libro != libros.end()) {
+                // Incrementa las copias disponibles (como si los devolviera forzosamente)
+                it_libro->second.copias_disponibles++;
+                actualizar_copias(it_libro->first, it_libro->second);
+            }
+        }
+
+        // 2. Eliminar PRÉSTAMOS asociados a este usuario (solo los de su lista inversa)
+        auto it_prestamos = prestamos_usuario.find(ids_usuario.buscar(ClaveUsuario::de(uid)));
+        if (it_prestamos != prestamos_usuario.end()) {
+            // Se saca la lista antes: borrar_prestamo la modifica
+            unordered_set<string> prestamos_a_borrar = std::move(it_prestamos->second);
+            prestamos_usuario.erase(it_prestamos);
+            for (const string& pid : prestamos_a_borrar) {
+                borrar_prestamo(pid);
+            }
+        }
+
+        // 3. Eliminar usuario de las listas de lectores y del mapa principal
+        desindexar_lector(u);
+        usuarios.erase(uid);
+    }
+
+    // Revierte el alta de un usuario (deshacer): lo quita del mapa, sin cascada
+    void aplicarRetiroUsuario(const string& uid) {
+        auto it = usuarios.find(uid);
+        if (it != usuarios.end()) {
+            desindexar_lector(it->second);
+            usuarios.erase(it);
+        }
+    }
+
+    // Registra un préstamo con ID conocido: descuenta stock, actualiza usuario y grafo
+    void aplicarPrestamo(const string& pid, const string& id_usuario, const string& isbn) {
+        // Ambos extremos deben existir (la bitácora puede referirse a datos ya borrados)
+        if (!usuarios.count(id_usuario) || !libros.count(isbn)) {
+            return;
+        }
+        
+        // Reduce el inventario disponible
+        libros[isbn].copias_disponibles -= 1;
+        actualizar_copias(isbn, libros[isbn]);
+        
+        // Entrega el libro al usuario (préstamos activos, historial y grafo)
+        asignar_prestamo(pid, id_usuario, isbn);
+    }
+
+    // Parte común de un préstamo directo y de una asignación desde la lista de espera
+    void asignar_prestamo(const string& pid, const string& id_usuario, const string& isbn) {
+        // Obtiene referencia al usuario
+        Usuario& u = usuarios[id_usuario];
+        // Claves y números del libro y del usuario
+        ClaveIsbn clave = ClaveIsbn::de(isbn);
+        ClaveUsuario clave_usuario = ClaveUsuario::de(id_usuario);
+        uint32_t n_libro = isbns.id(clave);
+        uint32_t n_usuario = ids_usuario.id(clave_usuario);
+        
+        // Registra el libro en los préstamos activos del usuario
+        u.agregar_activo(clave);
+        // El usuario pasa a ser lector del libro (lista inversa para las cascadas)
+        agregar_lector(n_libro, n_usuario);
+        
+        // Lo añade al historial general de lecturas
+        u.historial_isbn.push_back(clave);
+        
+        // Incrementa contador de préstamos
+        u.num_prestamos_activos++;
+        // Su línea de usuarios.csv cambió
+        u.fila_csv.clear();
+
+        // --- Actualizar GRAFO de conexiones (para recomendaciones) ---
+        // Conecta este nuevo libro con todos los libros previos del historial del usuario
+        for (ClaveIsbn otro : u.historial_isbn) {
+            // Evita conectarse consigo mismo
+            if (otro == clave) {
+                continue;
+            }
+            // Incrementa peso bidireccional
+            uint32_t n_otro = isbns.id(otro);
+            fila_grafo(n_libro)[n_otro] += 1;
+            fila_grafo(n_otro)[n_libro] += 1;
+        }
+
+        // Crear objeto Préstamo
+        Prestamo P;
+        P.id_prestamo = pid;
+        P.isbn = clave;
+        P.id_usuario = clave_usuario;
+        P.activo = true;
+        
+        // Guardar préstamo en el mapa y en el índice de activos
+        indexar_prestamo(P);
+        prestamos[P.id_prestamo] = P;
+    }
+
+    // Copia a las columnas las copias disponibles de un libro tras cambiarlas en el mapa
+    void actualizar_copias(const string& isbn, const Libro& l) {
+        uint32_t n = isbns.buscar(ClaveIsbn::de(isbn));
+        if (n < catalogo.size()) {
+            catalogo.copias_disponibles[n] = l.copias_disponibles;
+        }
+    }
+
+    // Fila del grafo de un libro (el vector crece si el número es nuevo)
+    unordered_map<uint32_t, int>& fila_grafo(uint32_t n_libro) {
+        if (n_libro >= grafico_libro.size()) {
+            grafico_libro.resize(n_libro + 1);
+        }
+        return grafico_libro[n_libro];
     }
 
-    // Parser CSV: Divide una línea en campos respetando comillas
-    vector<string> parse_csv_line(const string& line, char delimiter) {
-        // Vector para guardar los campos resultantes
-        vector<string> result;
-        // String temporal para construir el campo actual
-        string field;
-        // Bandera para saber si estamos dentro de un bloque entrecomillado
-        bool in_quotes = false;
-        
-        // Itera sobre cada carácter de la línea
-        for (size_t i = 0; i < line.length(); ++i) {
-            char c = line[i];
-            
-            // Si encontramos una comilla
-            if (c == '"') {
-                // Verificar si es una comilla escapada (doble comilla "")
-                if (in_quotes && i + 1 < line.length() && line[i + 1] == '"') {
-                    // Añadir una sola comilla al campo
-                    field += '"';
-                    // Saltar el siguiente carácter porque ya lo procesamos
-                    i++;
-                }
-                else {
-                    // Si no es escapada, invertimos el estado (entrar/salir de comillas)
-                    in_quotes = !in_quotes;
-                }
-            }
-            // Si encontramos el delimitador Y NO estamos dentro de comillas
-            else if (c == delimiter && !in_quotes) {
-                // El campo ha terminado, lo guardamos en el vector
-                result.push_back(field);
-                // Limpiamos el string temporal para el siguiente campo
-                field.clear();
-            }
-            // Carácter normal
-            else {
-                // Lo añadimos al campo actual
-                field += c;
-            }
+    // Clave del índice de préstamos activos: número de usuario arriba, número de ISBN abajo
+    static uint64_t clave_prestamo(uint32_t n_usuario, uint32_t n_libro) {
+        return (static_cast<uint64_t>(n_usuario) << 32) | n_libro;
+    }
+
+    // Añade un préstamo activo al índice (usuario, ISBN) -> ID y a las listas por libro y por usuario
+    void indexar_prestamo(const Prestamo& p) {
+        uint32_t n_libro = isbns.id(p.isbn);
+        uint32_t n_usuario = ids_usuario.id(p.id_usuario);
+        vector<string>& ids = prestamo_activo[clave_prestamo(n_usuario, n_libro)];
+        // Un préstamo reescrito con el mismo ID (bitácora repetida) no se duplica
+        if (find(ids.begin(), ids.end(), p.id_prestamo) == ids.end()) {
+            ids.push_back(p.id_prestamo);
         }
-        // Añadimos el último campo (lo que quedó en 'field' tras el bucle)
-        result.push_back(field);
-        // Retornamos el vector de campos
-        return result;
+        prestamos_libro[n_libro].insert(p.id_prestamo);
+        prestamos_usuario[n_usuario].insert(p.id_prestamo);
     }
 
-    // Función auxiliar para unir un vector de strings en una sola cadena con separador
-    static string join(const vector<string>& v, const string& sep) {
-        // String acumulador
-        string out;
-        // Itera por los elementos del vector
-        for (size_t i = 0; i < v.size(); ++i) {
-            // Si no es el primer elemento, añade el separador antes
-            if (i) {
-                out += sep;
+    // Quita un préstamo de los índices de activos (al cerrarlo, anularlo o borrarlo en cascada)
+    void desindexar_prestamo(const Prestamo& p) {
+        // Un préstamo indexado tiene ambos números
+        uint32_t n_libro = isbns.buscar(p.isbn);
+        uint32_t n_usuario = ids_usuario.buscar(p.id_usuario);
+        if (n_libro == SIN_NUMERO || n_usuario == SIN_NUMERO) {
+            return;
+        }
+        auto it = prestamo_activo.find(clave_prestamo(n_usuario, n_libro));
+        if (it != prestamo_activo.end()) {
+            vector<string>& ids = it->second;
+            ids.erase(remove(ids.begin(), ids.end(), p.id_prestamo), ids.end());
+            if (ids.empty()) {
+                prestamo_activo.erase(it);
             }
-            // Añade el elemento actual
-            out += v[i];
         }
-        // Retorna la cadena unida
-        return out;
+        quitar_de_lista(prestamos_libro, n_libro, p.id_prestamo);
+        quitar_de_lista(prestamos_usuario, n_usuario, p.id_prestamo);
     }
-    // --- Funciones de CSV ---
-    
-    // Función para cargar los libros desde el archivo CSV al iniciar el programa
-    void cargarLibrosCSV() {
-        // Abre el archivo de lectura
-        ifstream file(LIBROS_CSV);
-        // Verifica si el archivo se abrió correctamente
-        if (!file.is_open()) {
-            // Si falla, imprime mensaje de error
-            cout << "Archivo " << LIBROS_CSV << " no encontrado." << endl;
-            // Sale de la función
+
+    // Quita 'valor' de la lista inversa de 'clave' (y la lista, si queda vacía)
+    template <typename V>
+    static void quitar_de_lista(unordered_map<uint32_t, unordered_set<V>>& listas, uint32_t clave, const V& valor) {
+        auto it = listas.find(clave);
+        if (it == listas.end()) {
             return;
         }
-        // Variable para almacenar cada línea leída
-        string line;
-        // Lee la primera línea (encabezado) para descartarla
-        getline(file, line); 
-        
-        // Bucle para leer el resto del archivo línea por línea
-        while (getline(file, line)) {
-            // Parsea la línea separando por comas y respetando comillas
-            vector<string> campos = parse_csv_line(line, DELIMITADOR);
-            
-            // Verifica que la línea tenga al menos los 7 campos requeridos
-            if (campos.size() >= 7) {
-                // Crea un objeto Libro temporal
-                Libro l;
-                // Asigna el ISBN limpiando espacios (campo 0)
-                l.isbn = trim(campos[0]);
-                
-                // Limpia el ISBN dejando solo dígitos para consistencia
-                l.isbn.erase(remove_if(l.isbn.begin(), l.isbn.end(),
-                    [](unsigned char c) { return !isdigit(c); }), l.isbn.end());
-                
-                // Asigna el título limpiando espacios (campo 1)
-                l.titulo = trim(campos[1]);
-                
-                // Procesa los autores (campo 2), separados internamente por '^'
-                stringstream ss_autores(campos[2]);
-                string autor;
-                // Limpia el vector de autores por seguridad
-                l.autores.clear();
-                
-                // Itera sobre el stringstream usando '^' como delimitador
-                while (getline(ss_autores, autor, '^')) {
-                    // Si el autor extraído no está vacío
-                    if (!autor.empty()) {
-                        // Lo añade a la lista de autores del libro
-                        l.autores.push_back(autor);
-                    }
-                }
-                
-                // Asigna el género (campo 3)
-                l.genero = trim(campos[3]);
-                // Asigna la fecha de publicación (campo 4)
-                l.fecha_publi = campos[4];
-                
-                // Bloque try-catch para convertir strings a enteros (copias)
-                try {
-                    // Convierte copias totales (campo 5)
-                    l.copias_totales = stoi(campos[5]);
-                    // Convierte copias disponibles (campo 6)
-                    l.copias_disponibles = stoi(campos[6]);
-                }
-                catch (const invalid_argument&) {
-                    // Si falla la conversión, muestra error
-                    cerr << "Error al convertir copias en linea: " << line << endl;
-                    // Salta a la siguiente iteración del while (ignora este libro)
-                    continue;
-                }
-                
-                // Bloque try-catch para convertir ISBN a número (para AVL)
-                try {
-                    // Intenta convertir el string ISBN a long long
-                    l.isbn_num = stoll(l.isbn);
-                }
-                catch (...) {
-                    // Si falla (por ejemplo contiene letras), asigna 0
-                    l.isbn_num = 0;
-                }
-                
-                // Guarda el libro en el mapa principal usando el ISBN como clave
-                libros[l.isbn] = l;
-                // Actualiza el índice Título -> ISBN
-                indice[l.titulo] = l.isbn;
-                
-                // Llama a función auxiliar para indexar el Título en el Trie
-                indexar_termino(l.titulo, l.isbn); 
-                
-                // Itera sobre los autores para indexarlos también
-                for (const string& autor : l.autores) {
-                    // Indexa cada autor en el Trie vinculado a este ISBN
-                    indexar_termino(autor, l.isbn); 
-                }
-                
-                // Si el ISBN numérico es válido, lo inserta en el árbol AVL
-                if (l.isbn_num != 0) {
-                    isbn_avl.insertar(l.isbn_num, l.isbn);
-                }
-            }
+        it->second.erase(valor);
+        if (it->second.empty()) {
+            listas.erase(it);
         }
-        // Cierra el archivo
-        file.close();
-        // Mensaje de confirmación
-        cout << "Libros cargados desde " << LIBROS_CSV << endl;
     }
 
-    // Función para guardar el estado actual de los libros en el CSV
-    void guardarLibrosCSV() {
-        // Abre el archivo para escritura (sobreescribe contenido previo)
-        ofstream file(LIBROS_CSV);
-        // Verifica si se pudo abrir
-        if (!file.is_open()) {
-            // Muestra error si falla
-            cerr << "Error, no se pudo abrir " << LIBROS_CSV << endl;
+    // Borra un préstamo activo de la memoria y de sus índices (cascadas de bajas)
+    void borrar_prestamo(const string& pid) {
+        auto it = prestamos.find(pid);
+        if (it == prestamos.end()) {
             return;
         }
-        // Escribe el encabezado del CSV
-        file << "isbn,titulo,autores,genero,fecha_publi,copias_totales,copias_disponibles\n";
-        
-        // Itera sobre todos los libros en memoria
-        for (const auto& pair : libros) {
-            // Obtiene referencia al objeto libro
-            const Libro& b = pair.second;
-            // Convierte el vector de autores a string separado por '^'
-            string autores_str = join(b.autores, "^");
-            
-            // Escribe los campos en el archivo, usando csv_quote para seguridad
-            file << csv_quote(b.isbn) << DELIMITADOR
-                << csv_quote(b.titulo) << DELIMITADOR
-                << csv_quote(autores_str) << DELIMITADOR
-                << csv_quote(b.genero) << DELIMITADOR
-                << csv_quote(b.fecha_publi) << DELIMITADOR
-                << b.copias_totales << DELIMITADOR
-                << b.copias_disponibles << "\n"; // Salto de línea al final
+        desindexar_prestamo(it->second);
+        prestamos.erase(it);
+    }
+
+    // Llena la lista de lectores de cada libro a partir de los usuarios cargados
+    // (las de préstamos se llenan al cargarlos)
+    void construirListasInversas() {
+        lectores_libro.clear();
+        for (const auto& par : usuarios) {
+            indexar_lector(par.second);
         }
-        // Cierra el archivo
-        file.close();
     }
 
-    // Función para construir el grafo de recomendaciones basado en historiales
-    void inicializarGrafo() {
-        // Limpia cualquier dato previo en el grafo
-        grafico_libro.clear();
-        
-        // Itera sobre todos los usuarios registrados
-        for (const auto& par_u : usuarios) {
-            // Obtiene referencia al usuario
-            const Usuario& u = par_u.second;
-            
-            // Bucle anidado para comparar todos los libros que ha leído este usuario entre sí
-            // Itera desde el primer libro del historial
-            for (size_t i = 0; i < u.historial_isbn.size(); ++i) {
-                // Itera desde el siguiente libro (para hacer pares únicos)
-                for (size_t j = i + 1; j < u.historial_isbn.size(); ++j) {
-                    // Obtiene ISBN del primer libro
-                    const string& isbn1 = u.historial_isbn[i];
-                    // Obtiene ISBN del segundo libro
-                    const string& isbn2 = u.historial_isbn[j];
-                    
-                    // Verifica que ambos libros sigan existiendo en la base de datos
-                    if (libros.count(isbn1) && libros.count(isbn2)) {
-                        // Incrementa el peso de la conexión isbn1 -> isbn2
-                        grafico_libro[isbn1][isbn2] += 1;
-                        // Incrementa el peso de la conexión inversa (grafo no dirigido)
-                        grafico_libro[isbn2][isbn1] += 1;
-                    }
-                }
-            }
+    // Registra al usuario como lector de sus préstamos activos y de su historial
+    void indexar_lector(const Usuario& u) {
+        uint32_t n_usuario = ids_usuario.id(ClaveUsuario::de(u.id_usuario));
+        for (ClaveIsbn isbn : u.prestamos_activos) {
+            agregar_lector(isbns.id(isbn), n_usuario);
+        }
+        for (ClaveIsbn isbn : u.historial_isbn) {
+            agregar_lector(isbns.id(isbn), n_usuario);
         }
     }
-    // Cargar Usuarios desde el archivo CSV
-    void cargarUsuariosCSV() {
-        // Abre el archivo de usuarios para lectura
-        ifstream file(USUARIOS_CSV);
-        
-        // Verifica si el archivo no se pudo abrir (probablemente no existe)
-        if (!file.is_open()) {
-            // Informa al usuario que el archivo no existe
-            cout << "Archivo " << USUARIOS_CSV << " no encontrado. Creando archivo vacío." << endl;
-            // Crea un archivo vacío para evitar errores futuros
-            guardarUsuariosCSV();
-            // Sale de la función
+
+    // Anota al usuario como lector del libro; si es un lector nuevo, el libro sube de puntaje
+    // en el autocompletado
+    void agregar_lector(uint32_t n_libro, uint32_t n_usuario) {
+        if (lectores_libro[n_libro].insert(n_usuario).second) {
+            refrescar_libro(n_libro);
+        }
+    }
+
+    // Quita al usuario de los lectores del libro (y el libro baja de puntaje)
+    void quitar_lector(uint32_t n_libro, uint32_t n_usuario) {
+        quitar_de_lista(lectores_libro, n_libro, n_usuario);
+        refrescar_libro(n_libro);
+    }
+
+    // Quita al usuario de las listas de lectores (al darlo de baja)
+    void desindexar_lector(const Usuario& u) {
+        // Quien fue indexado como lector ya tiene número, igual que sus libros
+        uint32_t n_usuario = ids_usuario.buscar(ClaveUsuario::de(u.id_usuario));
+        if (n_usuario == SIN_NUMERO) {
             return;
         }
-        
-        // Variable para leer líneas
-        string line;
-        // Lee la primera línea (cabecera) y la descarta
-        getline(file, line); 
-        
-        // Bucle para leer cada línea de datos del usuario
-        while (getline(file, line)) {
-            // Parsea la línea usando la coma como delimitador
-            vector<string> campos = parse_csv_line(line, DELIMITADOR);
-            
-            // Verifica que la línea tenga los 6 campos esperados
-            // id, nombre, correo, prestamos_activos, historial_isbn, historial_titulos
-            if (campos.size() >= 6) {
-                // Crea un objeto Usuario temporal
-                Usuario u;
-                // Asigna ID (campo 0)
-                u.id_usuario = campos[0];
-                // Asigna Nombre (campo 1)
-                u.nombre = campos[1];
-                // Asigna Correo (campo 2)
-                u.correo = campos[2];
-                
-                // --- Deserializar prestamos_activos (Campo 3) ---
-                // Limpia el conjunto por seguridad
-                u.prestamos_activos.clear();
-                // Crea un stream con el contenido del campo 3
-                stringstream ss_pa(campos[3]);
-                string isbn_pa;
-                // Itera sobre el stream usando '^' como separador de ISBNs
-                while (getline(ss_pa, isbn_pa, '^')) {
-                    // Si el segmento no está vacío
-                    if (!isbn_pa.empty()) {
-                        // Lo inserta en el conjunto de préstamos activos
-                        u.prestamos_activos.insert(isbn_pa);
-                    }
-                }
-                
-                // --- Deserializar historial_isbn (Campo 4) ---
-                // Limpia el vector por seguridad
-                u.historial_isbn.clear();
-                // Crea un stream con el contenido del campo 4
-                stringstream ss_h(campos[4]);
-                string isbn_h;
-                // Itera sobre el stream usando '^' como separador
-                while (getline(ss_h, isbn_h, '^')) {
-                    // Si el segmento no está vacío
-                    if (!isbn_h.empty()) {
-                        // Lo añade al historial de ISBNs
-                        u.historial_isbn.push_back(isbn_h);
-                    }
-                }
-                
-                // --- Deserializar historial_titulos (Campo 5) ---
-                // Limpia el vector por seguridad
-                u.historial_titulos.clear();
-                // Crea un stream con el contenido del campo 5
-                stringstream ss_t(campos[5]);
-                string tit;
-                // Itera sobre el stream usando '^' como separador
-                while (getline(ss_t, tit, '^')) {
-                    // Si el título no está vacío
-                    if (!tit.empty()) {
-                        // Lo añade al historial de títulos
-                        u.historial_titulos.push_back(tit);
-                    }
-                }
-                
-                // Guarda el usuario reconstruido en el mapa principal
-                usuarios[u.id_usuario] = u;
+        for (ClaveIsbn isbn : u.prestamos_activos) {
+            uint32_t n_libro = isbns.buscar(isbn);
+            if (n_libro != SIN_NUMERO) {
+                quitar_lector(n_libro, n_usuario);
+            }
+        }
+        for (ClaveIsbn isbn : u.historial_isbn) {
+            uint32_t n_libro = isbns.buscar(isbn);
+            if (n_libro != SIN_NUMERO) {
+                quitar_lector(n_libro, n_usuario);
             }
         }
-        // Cierra el archivo
-        file.close();
-        // Mensaje de éxito
-        cout << "Usuarios cargados desde " << USUARIOS_CSV << endl;
     }
 
-    // Guardar Usuarios en el archivo CSV
-    void guardarUsuariosCSV() {
-        // Abre el archivo para escritura (trunca el contenido existente)
-        ofstream file(USUARIOS_CSV);
-        
-        // Verifica si el archivo se abrió correctamente
-        if (!file.is_open()) {
-            // Muestra error si no se pudo abrir
-            cerr << "Error: No se pudo abrir " << USUARIOS_CSV << " para escritura." << endl;
+    // ID del préstamo activo más antiguo de 'id_usuario' sobre 'isbn' ("" si no tiene ninguno)
+    string buscar_prestamo_activo(const string& id_usuario, const string& isbn) const {
+        uint32_t n_libro = isbns.buscar(ClaveIsbn::de(isbn));
+        uint32_t n_usuario = ids_usuario.buscar(ClaveUsuario::de(id_usuario));
+        if (n_libro == SIN_NUMERO || n_usuario == SIN_NUMERO) {
+            return "";
+        }
+        auto it = prestamo_activo.find(clave_prestamo(n_usuario, n_libro));
+        return it == prestamo_activo.end() ? "" : it->second.front();
+    }
+
+    // Revierte un préstamo (deshacer): borra el registro y recupera la copia
+    void aplicarAnulacionPrestamo(const string& pid) {
+        // Si el préstamo no existe no hay nada que revertir
+        if (!prestamos.count(pid)) {
             return;
         }
+        // Obtiene una copia del objeto préstamo antes de borrarlo
+        Prestamo P = prestamos[pid];
         
-        // Escribe la cabecera del CSV
-        file << "id_usuario,nombre,correo,prestamos_activos,historial_isbn,historial_titulos_lectura\n";
+        // 1. Borrar el registro del préstamo del mapa y del índice de activos
+        desindexar_prestamo(P);
+        prestamos.erase(pid);
         
-        // Itera sobre todos los usuarios en memoria
-        for (const auto& pair : usuarios) {
-            // Obtiene referencia al usuario actual
-            const Usuario& u = pair.second;
-            
-            // Serializa el set de préstamos activos a un string separado por '^'
-            string prestamos_str = join(vector<string>(u.prestamos_activos.begin(), u.prestamos_activos.end()), "^");
-            
-            // Serializa el historial de ISBNs a un string separado por '^'
-            string historial_isbn_str = join(u.historial_isbn, "^");
-            
-            // --- Lógica para reconstruir historial de títulos ---
-            // Vector temporal para los títulos
-            vector<string> historial_titulos_vec;
-            
-            // Recorre el historial de ISBNs para buscar los títulos actuales
-            for (const string& isbn : u.historial_isbn) {
-                // Si el libro existe en la base de datos actual
-                if (libros.count(isbn)) {
-                    // Obtiene el título real y actualizado
-                    historial_titulos_vec.push_back(libros.at(isbn).titulo);
-                }
-                else {
-                    // Si el libro fue borrado, marca como NO ENCONTRADO temporalmente
-                    historial_titulos_vec.push_back("ISBN_NO_ENCONTRADO");
-                }
-            }
+        // 2. Recuperar la copia del libro (incrementar stock disponible)
+        auto it_libro = libros.find(P.isbn.texto());
+        if (it_libro != libros.end()) {
+            it_libro->second.copias_disponibles += 1;
+            actualizar_copias(it_libro->first, it_libro->second);
+        }
+        
+        // 3. Quitar del historial activo del usuario
+        auto it_usuario = usuarios.find(P.id_usuario.texto());
+        if (it_usuario != usuarios.end()) {
+            Usuario& u = it_usuario->second;
+            // Borra el ISBN del set de préstamos activos
+            u.quitar_activo(P.isbn);
             
-            // Si el usuario ya tenía un historial de títulos explícito (cargado o guardado previamente)
-            // Esto es crucial para preservar títulos de libros que ya se eliminaron de la biblioteca
-            if (!u.historial_titulos.empty()) {
-                // Sobreescribe la versión reconstruida con la versión histórica
-                historial_titulos_vec = u.historial_titulos;
+            // Decrementa el contador de préstamos activos
+            if (u.num_prestamos_activos > 0) {
+                u.num_prestamos_activos--;
             }
+            // Su línea de usuarios.csv cambió
+            u.fila_csv.clear();
             
-            // Serializa el vector de títulos a string separado por '^'
-            string historial_titulos_str = join(historial_titulos_vec, "^");
-            
-            // Escribe la línea completa en el CSV, entrecomillando cada campo
-            file << csv_quote(u.id_usuario) << DELIMITADOR
-                << csv_quote(u.nombre) << DELIMITADOR
-                << csv_quote(u.correo) << DELIMITADOR
-                << csv_quote(prestamos_str) << DELIMITADOR
-                << csv_quote(historial_isbn_str) << DELIMITADOR
-                << csv_quote(historial_titulos_str) << "\n";
-        }
-        // Cierra el archivo
-        file.close();
+            // Nota: Quitarlo del historial_isbn histórico es complejo porque no sabemos 
+            // si el usuario ya había leído este libro antes en otra ocasión. 
+            // Por seguridad, solo revertimos el estado "activo".
+        }
     }
-    // --- Cargar/Guardar prestamos ---
-    
-    // Carga los préstamos desde el archivo CSV
-    void cargarPrestamosCSV() {
-        // Abre el archivo de préstamos en modo lectura
-        ifstream file(PRESTAMOS_CSV);
+
+    // Cierra el préstamo 'pid_cerrado' y, si hay lista de espera, entrega el libro al siguiente
+    // usando 'pid_siguiente'. Retorna el ID del usuario que salió de la cola (o "" si no había nadie)
+    // El préstamo cerrado sale de la memoria y queda pendiente de anotar en el archivo con 'fecha'
+    string aplicarDevolucion(const string& id_usuario, const string& isbn, const string& pid_cerrado,
+                             const string& pid_siguiente, const string& fecha) {
+        // Ambos extremos y el préstamo deben existir
+        auto it_prestamo = prestamos.find(pid_cerrado);
+        if (!usuarios.count(id_usuario) || !libros.count(isbn) || it_prestamo == prestamos.end()) {
+            return "";
+        }
+
+        // Marca el préstamo como inactivo (finalizado) y lo mueve a los pendientes de archivar
+        desindexar_prestamo(it_prestamo->second);
+        Prestamo cerrado = std::move(it_prestamo->second);
+        prestamos.erase(it_prestamo);
+        cerrado.activo = false;
+        cerrado.fecha_cierre = fecha;
+        prestamos_cerrados.push_back(std::move(cerrado));
         
-        // Verifica si el archivo no existe o no se pudo abrir
-        if (!file.is_open()) {
-            // Informa que no se encontró el archivo
-            cout << "Archivo " << PRESTAMOS_CSV << " no encontrado. Creando archivo vacío." << endl;
-            // Crea un archivo vacío para evitar errores posteriores
-            guardarPrestamosCSV();
-            // Termina la ejecución de la función
-            return;
+        // Lo quita de la lista de activos del usuario
+        ClaveIsbn clave = ClaveIsbn::de(isbn);
+        usuarios[id_usuario].quitar_activo(clave);
+        
+        // Decrementa contador
+        if (usuarios[id_usuario].num_prestamos_activos > 0) {
+            usuarios[id_usuario].num_prestamos_activos--;
         }
         
-        // Variable para leer línea por línea
-        string line;
-        // Lee y descarta el encabezado
-        getline(file, line);
+        // Guarda el título en el historial de títulos (para persistencia visual)
+        usuarios[id_usuario].historial_titulos.push_back(libros[isbn].titulo);
+        // Su línea de usuarios.csv cambió
+        usuarios[id_usuario].fila_csv.clear();
+
+        // VERIFICAR COLA DE ESPERA (Lógica automática)
+        queue<uint32_t>& cola = lista_espera[isbns.id(clave)];
+        if (!cola.empty()) {
+            // A. Sacar al siguiente usuario de la fila
+            string siguiente_usuario = ids_usuario.nombre(cola.front()).texto();
+            cola.pop();
+
+            // B. Crear préstamo automático para él 
+            // IMPORTANTE: No incrementamos 'copias_disponibles' porque el libro pasa de una mano a otra inmediatamente.
+            if (usuarios.count(siguiente_usuario)) {
+                asignar_prestamo(pid_siguiente, siguiente_usuario, isbn);
+            }
+            return siguiente_usuario;
+        } 
+        
+        // Si nadie espera, el libro vuelve al estante
+        libros[isbn].copias_disponibles += 1;
+        actualizar_copias(isbn, libros[isbn]);
+        return "";
+    }
+
+    // Añade un usuario al final de la cola de espera de un libro
+    void aplicarEnCola(const string& isbn, const string& id_usuario) {
+        lista_espera[isbns.id(ClaveIsbn::de(isbn))].push(ids_usuario.id(ClaveUsuario::de(id_usuario)));
+    }
+
+    // Revierte una entrada en cola (deshacer): quita la primera aparición del usuario
+    void aplicarSalidaCola(const string& isbn, const string& id_usuario) {
+        // Si no hay cola para ese libro no hay nada que revertir
+        auto it_cola = lista_espera.find(isbns.buscar(ClaveIsbn::de(isbn)));
+        if (it_cola == lista_espera.end()) {
+            return;
+        }
+        // Número del usuario a quitar (SIN_NUMERO si nunca lo tuvo: no está en ninguna cola)
+        uint32_t n_usuario = ids_usuario.buscar(ClaveUsuario::de(id_usuario));
+        // Hay que reconstruir la cola quitando al usuario específico
+        // Copia la cola original
+        queue<uint32_t> original = it_cola->second;
+        // Crea una cola nueva vacía
+        queue<uint32_t> nueva;
+        // Bandera para asegurar que solo borramos una instancia (la primera)
+        bool eliminado = false;
         
-        // Itera mientras haya líneas en el archivo
-        while (getline(file, line)) {
-            // Parsea la línea separando por comas
-            vector<string> campos = parse_csv_line(line, DELIMITADOR);
+        // Recorre la cola original vaciándola
+        while (!original.empty()) {
+            uint32_t u = original.front();
+            original.pop();
             
-            // Verifica que existan al menos los 6 campos requeridos
-            // id_prestamo, isbn, id_usuario, nombre_usuario, titulo, activo
-            if (campos.size() >= 6) {
-                // Crea objeto Prestamo temporal
-                Prestamo p;
-                // Asigna ID del préstamo (campo 0)
-                p.id_prestamo = campos[0];
-                // Asigna ISBN (campo 1)
-                p.isbn = campos[1];
-                // Asigna ID del usuario (campo 2)
-                p.id_usuario = campos[2];
-                // Convierte el texto "true" o "false" a booleano (campo 5)
-                p.activo = (campos[5] == "true");
-                
-                // Guarda el préstamo en el mapa usando su ID como clave
-                prestamos[p.id_prestamo] = p;
+            // Si encontramos al usuario y aún no lo hemos eliminado
+            if (!eliminado && u == n_usuario) {
+                eliminado = true; // Lo saltamos (efectivamente borrándolo)
+            } 
+            else {
+                // Si no es él (o ya lo borramos antes), lo pasamos a la nueva cola
+                nueva.push(u);
             }
         }
-        // Cierra el archivo
-        file.close();
-        // Mensaje de éxito
-        cout << "Prestamos cargados desde " << PRESTAMOS_CSV << endl;
+        // Reemplaza la cola vieja con la nueva filtrada
+        it_cola->second = nueva;
     }
 
-    // Guarda los préstamos actuales en el archivo CSV
-    void guardarPrestamosCSV() {
-        // Abre el archivo para escritura (sobrescribe)
-        ofstream file(PRESTAMOS_CSV);
-        
-        // Verifica errores de apertura
-        if (!file.is_open()) {
-            // Muestra error en salida estándar de error
-            cerr << "Error: No se pudo abrir " << PRESTAMOS_CSV << " para escritura." << endl;
+    // Función auxiliar para generar un ID de préstamo único
+    string generar_id_prestamo() {
+        // Retorna "P" seguido de 8 dígitos aleatorios
+        return "P" + generar_id_aleatorio(8);
+    }
+
+    // Normaliza un término de búsqueda (minúsculas)
+    static string normalizar_termino(string texto) {
+        // Itera sobre cada carácter para normalizar (minusculas)
+        // CORRECCIÓN: Usar unsigned char para evitar corrupción con tildes/caracteres especiales
+        for (auto& c : texto) {
+            c = tolower(static_cast<unsigned char>(c));
+        }
+        return texto;
+    }
+
+    // Helper privado para indexar texto en Trie y Mapa de búsqueda
+    void indexar_termino(string texto, uint32_t n_libro) {
+        // Si el texto está vacío, no hay nada que indexar
+        if (texto.empty()) {
             return;
         }
         
-        // Escribe encabezado
-        file << "id_prestamo,isbn,id_usuario,nombre_usuario,titulo,activo\n";
+        // Normaliza a minúsculas
+        texto = normalizar_termino(std::move(texto));
         
-        // Itera sobre el mapa de préstamos
-        for (const auto& pair : prestamos) {
-            // Referencia al objeto préstamo
-            const Prestamo& p = pair.second;
-            
-            // Busca el nombre del usuario para guardarlo como referencia legible (desnormalización)
-            // Si el usuario ya no existe, pone "NO ENCONTRADO"
-            string nombre_usuario = usuarios.count(p.id_usuario) ? usuarios.at(p.id_usuario).nombre : "NO ENCONTRADO";
-            
-            // Busca el título del libro para referencia legible
-            string titulo_libro = libros.count(p.isbn) ? libros.at(p.isbn).titulo : "NO ENCONTRADO";
-            
-            // Convierte el booleano a string "true"/"false"
-            string activo_str = p.activo ? "true" : "false";
-            
-            // Escribe la línea CSV con todos los campos entrecomillados
-            file << csv_quote(p.id_prestamo) << DELIMITADOR
-                << csv_quote(p.isbn) << DELIMITADOR
-                << csv_quote(p.id_usuario) << DELIMITADOR
-                << csv_quote(nombre_usuario) << DELIMITADOR
-                << csv_quote(titulo_libro) << DELIMITADOR
-                << activo_str << "\n";
+        // Mapea la palabra normalizada al número del ISBN (para saber qué libro es), una sola vez
+        vector<uint32_t>& lista = mapa_busqueda[texto];
+        if (find(lista.begin(), lista.end(), n_libro) == lista.end()) {
+            lista.push_back(n_libro);
         }
-        // Cierra el archivo
-        file.close();
+        
+        // Inserta la palabra normalizada en el árbol Trie (para autocompletado) con su puntaje
+        refrescar_termino(texto);
     }
 
-    // Carga la lista de espera (colas) desde el CSV
-    void cargarListaEsperaCSV() {
-        // Abre el archivo de lista de espera
-        ifstream file(LISTA_ESPERA_CSV);
-        
-        // Verifica si el archivo existe
-        if (!file.is_open()) {
-            // Si no existe, avisa y crea uno nuevo
-            cout << "Archivo " << LISTA_ESPERA_CSV << " no encontrado. Creando archivo vacío." << endl;
-            guardarListaEsperaCSV();
-            return; 
+    // Quita el libro de la palabra (ya normalizada); una palabra sin libros sale del mapa y del Trie
+    void desindexar_termino(const string& termino, uint32_t n_libro) {
+        auto it = mapa_busqueda.find(termino);
+        if (it == mapa_busqueda.end()) {
+            return;
         }
-        
-        // Variable para líneas
-        string line;
-        // Salta encabezado
-        getline(file, line); 
-        
-        // Lee el archivo línea a línea
-        while (getline(file, line)) {
-            // Parsea la línea
-            vector<string> campos = parse_csv_line(line, DELIMITADOR);
-            
-            // Se requieren al menos 2 campos: ISBN y la cadena de usuarios
-            if (campos.size() >= 2) {
-                // ISBN del libro en espera
-                string isbn = campos[0];
-                // String con los IDs de usuarios separados por '^'
-                string cadena_usuarios = campos[1];
-                
-                // Cola temporal para reconstruir la fila
-                queue<string> q;
-                // Stream para procesar la cadena de usuarios
-                stringstream ss(cadena_usuarios);
-                string u;
-                
-                // Itera sobre los usuarios separados por '^'
-                while (getline(ss, u, '^')) { 
-                    // Si el ID extraído no está vacío
-                    if (!u.empty()) {
-                        // Lo empuja a la cola
-                        q.push(u);
-                    }
-                }
-                
-                // Si la cola recuperada tiene gente, se guarda en el mapa
-                if (!q.empty()) {
-                    // std::move transfiere la propiedad de 'q' al mapa (eficiente)
-                    lista_espera[isbn] = std::move(q);
-                }
+        vector<uint32_t>& lista = it->second;
+        lista.erase(remove(lista.begin(), lista.end(), n_libro), lista.end());
+        if (lista.empty()) {
+            mapa_busqueda.erase(it);
+        }
+        refrescar_termino(termino);
+    }
+
+    // Palabras de búsqueda de un libro (título y autores), ya normalizadas
+    static vector<string> terminos_libro(const Libro& libro) {
+        vector<string> terminos;
+        if (!libro.titulo.empty()) {
+            terminos.push_back(normalizar_termino(libro.titulo));
+        }
+        for (const string& autor : libro.autores) {
+            if (!autor.empty()) {
+                terminos.push_back(normalizar_termino(autor));
+            }
+        }
+        return terminos;
+    }
+
+    // Quita el libro de sus palabras de búsqueda salvo de las que siga teniendo 'conservar'
+    // (los datos nuevos, en una modificación)
+    void desindexar_terminos(const Libro& libro, uint32_t n_libro, const Libro* conservar = nullptr) {
+        vector<string> siguen;
+        if (conservar) {
+            siguen = terminos_libro(*conservar);
+        }
+        for (const string& termino : terminos_libro(libro)) {
+            if (find(siguen.begin(), siguen.end(), termino) == siguen.end()) {
+                desindexar_termino(termino, n_libro);
+            }
+        }
+    }
+
+    // Puntaje de un libro para el autocompletado: cuántos usuarios lo tienen o lo leyeron
+    int puntaje_libro(uint32_t n_libro) const {
+        auto it = lectores_libro.find(n_libro);
+        return it == lectores_libro.end() ? 0 : static_cast<int>(it->second.size());
+    }
+
+    // Puntaje de una palabra: el de su libro más leído que siga en el catálogo (-1 si no le
+    // queda ninguno)
+    int puntaje_termino(const vector<uint32_t>& libros_termino) const {
+        int mejor = -1;
+        for (uint32_t n_libro : libros_termino) {
+            if (catalogo.contiene(n_libro)) {
+                mejor = max(mejor, puntaje_libro(n_libro));
             }
         }
-        // Cierra archivo
-        file.close();
-        // Mensaje de éxito
-        cout << "Lista de espera cargada desde " << LISTA_ESPERA_CSV << endl;
+        return mejor;
     }
 
-    // Guarda las colas de espera en el CSV
-    void guardarListaEsperaCSV() {
-        // Abre archivo para escritura
-        ofstream file(LISTA_ESPERA_CSV);
-        
-        // Validación de apertura
-        if (!file.is_open()) {
-            return;
-        }
-        
-        // Escribe encabezado
-        file << "isbn,cola_usuarios\n";
-        
-        // Itera sobre el mapa de listas de espera
-        for (auto& p : lista_espera) {
-            // ISBN (clave)
-            const string& isbn = p.first;
-            // Copia temporal de la cola porque 'std::queue' no es iterable directamente
-            // y al hacer pop() la vaciamos, así que necesitamos una copia para no borrar la memoria RAM
-            queue<string> q = p.second; 
-            
-            // Vector para construir la cadena
-            vector<string> usuarios_vec;
-            
-            // Vacía la copia de la cola para llenar el vector
-            while (!q.empty()) {
-                usuarios_vec.push_back(q.front());
-                q.pop();
+    // Pone en el Trie el puntaje actual de la palabra, o la quita si ya no tiene libros
+    void refrescar_termino(const string& termino) {
+        auto it = mapa_busqueda.find(termino);
+        // Durante la carga los puntajes se calculan todos juntos al final (puntuar_terminos)
+        if (!trie.con_mejores) {
+            if (it == mapa_busqueda.end()) {
+                trie.quitar(termino);
             }
-            
-            // Une el vector en un string separado por '^'
-            string cadena = join(usuarios_vec, "^");
-            
-            // Solo guardamos la línea si hay gente esperando
-            if (!cadena.empty()) {
-                file << csv_quote(isbn) << DELIMITADOR << csv_quote(cadena) << "\n";
+            else {
+                trie.insertar(termino);
             }
+            return;
+        }
+        int puntaje = it == mapa_busqueda.end() ? -1 : puntaje_termino(it->second);
+        if (puntaje < 0) {
+            trie.quitar(termino);
+        }
+        else {
+            trie.insertar(termino, puntaje);
         }
-        // Cierra archivo
-        file.close();
-    }
-
-    // Función auxiliar para generar un ID de préstamo único
-    string generar_id_prestamo() {
-        // Retorna "P" seguido de 8 dígitos aleatorios
-        return "P" + generar_id_aleatorio(8);
     }
 
-    // Helper privado para indexar texto en Trie y Mapa de búsqueda
-    void indexar_termino(string texto, const string& isbn) {
-        // Si el texto está vacío, no hay nada que indexar
-        if (texto.empty()) {
+    // Refresca las palabras del libro número 'n_libro' después de un cambio en sus lectores
+    void refrescar_libro(uint32_t n_libro) {
+        if (!trie.con_mejores) {
             return;
         }
-        
-        // Itera sobre cada carácter para normalizar (minusculas)
-        // CORRECCIÓN: Usar unsigned char para evitar corrupción con tildes/caracteres especiales
-        for (auto& c : texto) {
-            c = tolower(static_cast<unsigned char>(c));
+        auto it = libros.find(isbns.nombre(n_libro).texto());
+        if (it != libros.end()) {
+            for (const string& termino : terminos_libro(it->second)) {
+                refrescar_termino(termino);
+            }
         }
-        
-        // Inserta la palabra normalizada en el árbol Trie (para autocompletado)
-        trie.insertar(texto);
-        
-        // Mapea la palabra normalizada al ISBN (para saber qué libro es)
-        mapa_busqueda[texto].push_back(isbn);
+    }
+
+    // Calcula el puntaje de todas las palabras y arma las listas de mejores del Trie (una vez,
+    // al terminar la carga; desde ahí cada cambio las mantiene)
+    void puntuar_terminos() {
+        for (const auto& par : mapa_busqueda) {
+            int puntaje = puntaje_termino(par.second);
+            if (puntaje < 0) {
+                trie.quitar(par.first);
+            }
+            else {
+                trie.insertar(par.first, puntaje);
+            }
+        }
+        trie.recalcular_todo();
     }
     // Función privada que ejecuta la reversión de una acción específica
     void deshacer_accion(const Accion& a) { 
@@ -1056,28 +5475,13 @@ private:
         case TipoAccion::AgregarLibro: {
             // Verifica si el libro realmente existe en la base de datos
             if (libros.count(a.id)) {
-                // Borrado manual rápido del mapa principal
-                // Nota: No usamos quitarLibros() completo para evitar recursión o efectos secundarios no deseados aquí
-                libros.erase(a.id);
-                
-                // Borrar del índice (Título -> ISBN)
-                // Iterador para recorrer el mapa de índices
-                for (auto it = indice.begin(); it != indice.end(); ) {
-                    // Si el ISBN del índice coincide con el ID borrado
-                    if (it->second == a.id) {
-                        // Borra el elemento y actualiza el iterador al siguiente
-                        it = indice.erase(it);
-                    }
-                    else {
-                        // Avanza el iterador normalmente
-                        ++it;
-                    }
-                }
+                // Lo quita del mapa principal y del índice (sin cascada)
+                aplicarRetiroLibro(a.id);
                 // Mensaje de feedback
                 cout << "Acción revertida: Libro " << a.id << " eliminado." << endl;
                 
-                // Actualizar el archivo CSV para reflejar el cambio
-                guardarLibrosCSV();
+                // Anota la reversión en la bitácora
+                anotar_bitacora({ "LIBRO_RETIRO", a.id });
             }
             break;
         }
@@ -1099,12 +5503,12 @@ private:
             // Verifica si el usuario existe
             if (usuarios.count(a.id)) {
                 // Lo borra del mapa principal
-                usuarios.erase(a.id);
+                aplicarRetiroUsuario(a.id);
                 // Feedback
                 cout << "Acción revertida: Usuario " << a.id << " eliminado." << endl;
                 
-                // Actualizar el archivo CSV
-                guardarUsuariosCSV();
+                // Anota la reversión en la bitácora
+                anotar_bitacora({ "USUARIO_RETIRO", a.id });
             }
             break;
         }
@@ -1119,38 +5523,13 @@ private:
         case TipoAccion::PrestarLibro: {
             // a.id aquí es el ID del PRÉSTAMO, verificamos si existe
             if (prestamos.count(a.id)) {
-                // Obtiene una copia del objeto préstamo antes de borrarlo
-                Prestamo P = prestamos[a.id];
-                
-                // 1. Borrar el registro del préstamo del mapa
-                prestamos.erase(a.id);
-                
-                // 2. Recuperar la copia del libro (incrementar stock disponible)
-                if (libros.count(P.isbn)) {
-                    libros[P.isbn].copias_disponibles += 1;
-                }
-                
-                // 3. Quitar del historial activo del usuario
-                if (usuarios.count(P.id_usuario)) {
-                    // Borra el ISBN del set de préstamos activos
-                    usuarios[P.id_usuario].prestamos_activos.erase(P.isbn);
-                    
-                    // Decrementa el contador de préstamos activos
-                    if (usuarios[P.id_usuario].num_prestamos_activos > 0) {
-                        usuarios[P.id_usuario].num_prestamos_activos--;
-                    }
-                    
-                    // Nota: Quitarlo del historial_isbn histórico es complejo porque no sabemos 
-                    // si el usuario ya había leído este libro antes en otra ocasión. 
-                    // Por seguridad, solo revertimos el estado "activo".
-                }
+                // Borra el préstamo, recupera la copia y la quita de los activos del usuario
+                aplicarAnulacionPrestamo(a.id);
                 // Feedback
                 cout << "Acción revertida: Préstamo " << a.id << " cancelado." << endl;
 
-                // Actualizar TODOS los CSVs involucrados para mantener consistencia
-                guardarLibrosCSV();
-                guardarUsuariosCSV();
-                guardarPrestamosCSV();
+                // Anota la reversión en la bitácora
+                anotar_bitacora({ "PRESTAMO_ANULADO", a.id });
             }
             break;
         }
@@ -1165,35 +5544,13 @@ private:
         case TipoAccion::PonerenCola: {
             // a.id es el ISBN del libro
             // a.usuario es el ID del usuario
-            if (lista_espera.count(a.id)) {
-                // Hay que reconstruir la cola quitando al usuario específico
-                // Copia la cola original
-                queue<string> original = lista_espera[a.id];
-                // Crea una cola nueva vacía
-                queue<string> nueva;
-                // Bandera para asegurar que solo borramos una instancia (la primera)
-                bool eliminado = false;
-                
-                // Recorre la cola original vaciándola
-                while (!original.empty()) {
-                    string u = original.front();
-                    original.pop();
-                    
-                    // Si encontramos al usuario y aún no lo hemos eliminado
-                    if (!eliminado && u == a.usuario) {
-                        eliminado = true; // Lo saltamos (efectivamente borrándolo)
-                    } 
-                    else {
-                        // Si no es él (o ya lo borramos antes), lo pasamos a la nueva cola
-                        nueva.push(u);
-                    }
-                }
-                // Reemplaza la cola vieja con la nueva filtrada
-                lista_espera[a.id] = nueva;
+            if (lista_espera.count(isbns.buscar(ClaveIsbn::de(a.id)))) {
+                // Reconstruye la cola sin la primera aparición del usuario
+                aplicarSalidaCola(a.id, a.usuario);
                 
                 cout << "Acción revertida: Usuario " << a.usuario << " sacado de la cola de espera." << endl;
-                // Guarda cambios en CSV
-                guardarListaEsperaCSV();
+                // Anota la reversión en la bitácora
+                anotar_bitacora({ "COLA_RETIRO", a.id, a.usuario });
             }
             break;
         }
@@ -1208,52 +5565,257 @@ private:
 
 public:
     // Constructor de la clase Biblioteca
-    Biblioteca() {
-        // Carga los libros desde disco al iniciar
-        cargarLibrosCSV();
-        // Carga los usuarios desde disco
-        cargarUsuariosCSV();
-        // Carga los préstamos desde disco
-        cargarPrestamosCSV();
-        // Carga la lista de espera desde disco
-        cargarListaEsperaCSV();
+    // 'usar_snapshot' elige biblioteca.snap como base de arranque y de guardado;
+    // 'directorio' (terminado en '/') permite trabajar con archivos fuera del directorio actual
+    explicit Biblioteca(bool usar_snapshot = false, const string& directorio = "")
+        : LIBROS_CSV(directorio + "libros.csv"),
+          USUARIOS_CSV(directorio + "usuarios.csv"),
+          PRESTAMOS_CSV(directorio + "prestamos.csv"),
+          LISTA_ESPERA_CSV(directorio + "lista_espera.csv"),
+          BITACORA_CSV(directorio + "bitacora.csv"),
+          SNAPSHOT_BIN(directorio + "biblioteca.snap"),
+          COMPACTACION_PENDIENTE(directorio + "compactacion.pendiente"),
+          ARCHIVO_PRESTAMOS(directorio + "archivo_prestamos/") {
+        // Un corte a mitad de una compactación se termina antes de leer nada
+        if (!completar_reemplazo()) {
+            cerr << "Error: No se pudo terminar la compactacion pendiente (" << COMPACTACION_PENDIENTE << ")." << endl;
+        }
+        // Si la bitácora pendiente se escribió sobre la instantánea, hay que arrancar desde ella
+        // (y los CSV están atrasados hasta la próxima exportación)
+        csv_desactualizados = bitacora_sobre_snapshot();
+        modo_snapshot = usar_snapshot || csv_desactualizados;
+        // Mide el tiempo de lectura de las tablas
+        auto inicio = chrono::steady_clock::now();
+        
+        // En modo instantánea se intenta primero biblioteca.snap; si no existe se importan los CSV
+        if (!modo_snapshot || !cargarSnapshot()) {
+            // Carga libros, usuarios, préstamos y lista de espera desde disco (en paralelo)
+            cargarTablasCSV();
+        }
+        // Listas inversas de lectores y préstamos (la reproducción ya las mantiene)
+        construirListasInversas();
+        // Aplica encima de la base las operaciones anotadas desde la última compactación
+        reproducirBitacora();
+        // Con los lectores ya contados, puntúa las palabras del autocompletado
+        puntuar_terminos();
+        // Préstamos cerrados que todavía no llegaron al archivo (de la bitácora o de un
+        // prestamos.csv anterior al archivo): la tabla queda sucia para moverlos en el próximo volcado
+        if (!prestamos_cerrados.empty()) {
+            marcar_tabla_sucia(TABLA_PRESTAMOS);
+        }
+        ms_carga_tablas = chrono::duration<double, milli>(chrono::steady_clock::now() - inicio).count();
         // Inicializa el grafo de recomendaciones basado en los datos cargados
         inicializarGrafo();
+        // Desde aquí la bitácora la escribe el hilo escritor
+        escritor = thread(&Biblioteca::bucle_escritor, this);
+    }
+
+    // Destructor: al salir vuelca las tablas sucias y vacía la bitácora
+    ~Biblioteca() {
+        finalizar();
+    }
+
+    // Detiene el escritor (tras anotar todo lo encolado), vuelca las tablas sucias,
+    // vacía la bitácora y deja todo en disco
+    // (lo llama el destructor; puede llamarse antes para leer las estadísticas finales)
+    void finalizar() {
+        if (escritor.joinable()) {
+            {
+                lock_guard<mutex> lk(mutex_cola);
+                cerrando = true;
+            }
+            cv_escritor.notify_one();
+            escritor.join();
+        }
+        // Solo hace falta reescribir los CSV si quedaron cambios sin volcar
+        if (hay_tablas_sucias()) {
+            compactarBitacora();
+        }
+        // En modo instantánea los CSV (formato de exportación) se ponen al día al salir
+        if (csv_desactualizados) {
+            exportarCSV();
+        }
+        // Lo anotado que aún esperaba su fsync por grupo
+        sincronizar_bitacora(true);
+    }
+
+    // Elige cuándo se fuerza la bitácora a disco ('ms' es el plazo del modo por grupos)
+    void configurarDurabilidad(NivelDurabilidad nivel, long long ms) {
+        durabilidad = nivel;
+        ms_grupo = ms;
+        // El escritor recalcula su próximo plazo
+        cv_escritor.notify_one();
+    }
+
+    // Capacidad de la cola del hilo escritor y qué hacer cuando se llena
+    void configurarColaEscritura(size_t capacidad, PoliticaColaLlena politica) {
+        {
+            lock_guard<mutex> lk(mutex_cola);
+            capacidad_cola = max<size_t>(capacidad, 1);
+            politica_cola = politica;
+        }
+        // Una capacidad mayor puede liberar a quien esperaba
+        cv_productor.notify_all();
+    }
+
+    // Verdadero si la última operación fue rechazada por tener la cola de escritura llena
+    bool escrituraRechazada() {
+        lock_guard<mutex> lk(mutex_cola);
+        return ultima_rechazada;
+    }
+
+    // Copia de las métricas del hilo escritor
+    MetricasEscritor metricasEscritor() {
+        lock_guard<mutex> lk(mutex_cola);
+        MetricasEscritor m = metricas;
+        m.profundidad = cola_escritura.size();
+        m.capacidad = capacidad_cola;
+        return m;
+    }
+
+    // Profundidad de la cola, lotes y retraso de escritura de la bitácora
+    string reporteEscritor() {
+        MetricasEscritor m = metricasEscritor();
+        ostringstream out;
+        out << "  cola: " << m.profundidad << "/" << m.capacidad << " (maximo " << m.profundidad_maxima << ")\n";
+        out << "  registros escritos: " << m.registros_escritos << " en " << m.lotes << " lotes\n";
+        out << "  esperas por cola llena: " << m.esperas << ", rechazos: " << m.rechazos << "\n";
+        double promedio = m.registros_escritos ? m.retraso_total_ms / m.registros_escritos : 0;
+        out << "  retraso: ultimo " << m.retraso_ultimo_ms << " ms, promedio " << promedio
+            << " ms, maximo " << m.retraso_maximo_ms << " ms\n";
+        return out.str();
+    }
+
+    // Tiempo pasado en fsync por archivo (cantidad de llamadas y milisegundos)
+    string reporteSincronizacion() const {
+        ostringstream out;
+        auto linea = [&](const string& nombre, const ContadorSync& c) {
+            out << "  " << nombre << ": " << c.llamadas << " fsync, " << c.ms << " ms\n";
+        };
+        linea(LIBROS_CSV, sync_tablas[TABLA_LIBROS]);
+        linea(USUARIOS_CSV, sync_tablas[TABLA_USUARIOS]);
+        linea(PRESTAMOS_CSV, sync_tablas[TABLA_PRESTAMOS]);
+        linea(LISTA_ESPERA_CSV, sync_tablas[TABLA_LISTA_ESPERA]);
+        linea(BITACORA_CSV, sync_bitacora);
+        linea(SNAPSHOT_BIN, sync_snapshot);
+        linea(ARCHIVO_PRESTAMOS, sync_archivo);
+        return out.str();
+    }
+
+    // Préstamos cerrados de un usuario, leídos a pedido del archivo (de más antiguo a más reciente)
+    // 'periodo' (AAAA-MM) limita la búsqueda a un segmento; vacío recorre todos
+    vector<Prestamo> historialPrestamos(const string& id_usuario, const string& periodo = "") {
+        vector<Prestamo> res;
+        // IDs ya vistos: un corte durante el volcado puede dejar líneas repetidas
+        unordered_set<string> vistos;
+        lock_guard<mutex> lk_disco(mutex_disco);
+        
+        // Segmentos en orden de periodo (el nombre lleva AAAA-MM)
+        vector<string> rutas;
+        error_code ec;
+        if (periodo.empty()) {
+            for (const auto& entrada : filesystem::directory_iterator(ARCHIVO_PRESTAMOS, ec)) {
+                string nombre = entrada.path().filename().string();
+                if (nombre.rfind("prestamos_", 0) == 0 && entrada.path().extension() == ".csv") {
+                    rutas.push_back(entrada.path().string());
+                }
+            }
+            sort(rutas.begin(), rutas.end());
+        }
+        else {
+            rutas.push_back(ruta_segmento(periodo));
+        }
+        
+        // Recorre cada segmento sin cargarlo en las estructuras de la biblioteca
+        vector<string_view> c;
+        for (const string& ruta : rutas) {
+            LectorCSV lector;
+            if (!lector.abrir(ruta, DELIMITADOR)) {
+                continue;
+            }
+            // Salta la cabecera
+            lector.siguiente_fila(c);
+            while (lector.siguiente_fila(c)) {
+                if (c.size() < 6 || c[2] != id_usuario || !vistos.insert(string(c[0])).second) {
+                    continue;
+                }
+                Prestamo p;
+                p.id_prestamo = string(c[0]);
+                p.isbn = ClaveIsbn::de(c[1]);
+                p.id_usuario = ClaveUsuario::de(c[2]);
+                p.titulo = string(c[4]);
+                p.activo = false;
+                p.fecha_cierre = string(c[5]);
+                res.push_back(std::move(p));
+            }
+        }
+        
+        // Los cerrados desde el último volcado aún están en memoria
+        lock_guard<mutex> lk_estado(mutex_estado);
+        ClaveUsuario clave_usuario = ClaveUsuario::de(id_usuario);
+        for (const Prestamo& p : prestamos_cerrados) {
+            if (p.id_usuario == clave_usuario && (periodo.empty() || periodo_de(p.fecha_cierre) == periodo)
+                && vistos.insert(p.id_prestamo).second) {
+                res.push_back(p);
+                // El título se toma del catálogo actual, como al anotarlo
+                auto it = libros.find(p.isbn.texto());
+                res.back().titulo = it != libros.end() ? it->second.titulo : "NO ENCONTRADO";
+            }
+        }
+        return res;
+    }
+
+    // Escribe biblioteca.snap con el estado actual (la próxima carga en modo instantánea la usará)
+    void escribirSnapshot() {
+        string contenido;
+        {
+            lock_guard<mutex> lk(mutex_estado);
+            contenido = serializarSnapshot();
+        }
+        lock_guard<mutex> lk_disco(mutex_disco);
+        if (!contenido.empty()) {
+            escribir_archivo(SNAPSHOT_BIN, contenido, sync_snapshot, ios::binary);
+        }
+    }
+
+    // Milisegundos que tomó leer las tablas y reproducir la bitácora al arrancar
+    double tiempoCargaTablasMs() const {
+        return ms_carga_tablas;
+    }
+
+    // Milisegundos que toma armar el contenido de usuarios.csv en memoria (sin escribirlo)
+    double tiempoSerializarUsuariosMs() {
+        lock_guard<mutex> lk(mutex_estado);
+        auto inicio = chrono::steady_clock::now();
+        string contenido = serializarTabla(TABLA_USUARIOS);
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - inicio).count();
     }
     // ----- Libros -----
 
     // Función para agregar un nuevo libro al sistema
     bool agregarLibro(const Libro& libro) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return false;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Verifica si ya existe un libro con ese ISBN
         if (libros.count(libro.isbn)) {
             // Si existe, retorna falso indicando fallo
             return false;
         }
         
-        // Inserta el libro en el mapa principal
-        libros[libro.isbn] = libro;
-        
-        // Actualiza el índice de búsqueda por título
-        indice[libro.titulo] = libro.isbn;
-        
-        // Indexa el título en el Trie y mapa de búsqueda para autocompletado
-        indexar_termino(libro.titulo, libro.isbn); 
-        
-        // Itera sobre cada autor para indexarlo también
-        for (const string& autor : libro.autores) {
-            indexar_termino(autor, libro.isbn); 
-        }
-        
-        // Si el libro tiene un ISBN numérico válido, lo inserta en el árbol AVL
-        if (libro.isbn_num != 0) {
-            isbn_avl.insertar(libro.isbn_num, libro.isbn);
-        }
+        // Inserta el libro en el mapa principal y en los índices (Título, Trie, AVL)
+        aplicarAltaLibro(libro);
         
         // Registra la acción en el historial para poder deshacerla luego
         registrar_accion({ TipoAccion::AgregarLibro, libro.isbn, "", "" });
         
-        // Guarda los cambios en el archivo CSV inmediatamente
-        guardarLibrosCSV();
+        // Anota el alta en la bitácora (una línea en lugar de reescribir libros.csv)
+        vector<string> registro = campos_libro(libro);
+        registro.insert(registro.begin(), "LIBRO_ALTA");
+        anotar_bitacora(registro);
         
         // Retorna verdadero indicando éxito
         return true;
@@ -1261,150 +5823,46 @@ public:
 
     // Función compleja para eliminar un libro y limpiar todos sus rastros
     bool quitarLibros(const string& isbn) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return false;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Verifica si el libro existe
         if (!libros.count(isbn)) {
             return false;
         }
 
-        // 1. Limpiar PRÉSTAMOS asociados a este libro
-        // Vector auxiliar para guardar los IDs de los préstamos a borrar
-        // (No se debe borrar de un mapa mientras se itera sobre él)
-        vector<string> prestamos_a_borrar;
-        
-        // Itera sobre todos los préstamos
-        for (auto& par : prestamos) {
-            // Si el préstamo corresponde al libro que vamos a borrar
-            if (par.second.isbn == isbn) {
-                // Guarda el ID para borrarlo después
-                prestamos_a_borrar.push_back(par.first);
-            }
-        }
-        
-        // Borra los préstamos identificados
-        for (const string& pid : prestamos_a_borrar) {
-            prestamos.erase(pid);
-        }
-
-        // 2. Limpiar USUARIOS (Historiales y Préstamos Activos)
-        // Itera sobre todos los usuarios
-        for (auto& par_usuario : usuarios) {
-            Usuario& u = par_usuario.second;
-
-            // A. Si el usuario lo tiene prestado actualmente, lo quitamos del set activo
-            if (u.prestamos_activos.count(isbn)) {
-                u.prestamos_activos.erase(isbn);
-                // Actualiza el contador de préstamos activos (evita negativos con max)
-                u.num_prestamos_activos = max(0, u.num_prestamos_activos - 1);
-            }
-
-            // B. Limpiar del historial de ISBNs (vector)
-            // Usa el idioma erase-remove: 'remove' mueve los elementos a borrar al final
-            // y devuelve el iterador al nuevo final lógico.
-            auto it_isbn = remove(u.historial_isbn.begin(), u.historial_isbn.end(), isbn);
-            
-            // Si se encontraron elementos para borrar
-            if (it_isbn != u.historial_isbn.end()) {
-                // 'erase' elimina físicamente los elementos del vector
-                u.historial_isbn.erase(it_isbn, u.historial_isbn.end());
-            }
-
-            // C. Limpiar del historial de Títulos (vector de strings)
-            // Nota: Como estamos borrando el libro, necesitamos su título actual antes de que desaparezca
-            string titulo_a_borrar = libros[isbn].titulo;
-            
-            // Busca y elimina el título del historial de lectura del usuario
-            auto it_titulo = remove(u.historial_titulos.begin(), u.historial_titulos.end(), titulo_a_borrar);
-            
-            // Si se encontró, se borra
-            if (it_titulo != u.historial_titulos.end()) {
-                u.historial_titulos.erase(it_titulo, u.historial_titulos.end());
-            }
-        }
-
-        // 3. Eliminar del índice auxiliar (Titulo -> ISBN)
-        // Itera sobre el mapa de índices
-        for (auto it = indice.begin(); it != indice.end(); ) {
-            // Si encuentra la entrada que apunta a este ISBN
-            if (it->second == isbn) {
-                // Borra la entrada y actualiza el iterador
-                it = indice.erase(it);
-            }
-            else {
-                // Avanza al siguiente
-                ++it;
-            }
-        }
-
-        // 4. Eliminar el libro del mapa principal
-        libros.erase(isbn);
+        // Limpia préstamos, historiales de usuarios e índice, y borra el libro
+        aplicarBajaLibro(isbn);
 
-        // 5. GUARDAR TODO (Para mantener sincronía entre archivos)
-        guardarLibrosCSV();    // El libro desaparece
-        guardarPrestamosCSV(); // Los préstamos huérfanos desaparecen
-        guardarUsuariosCSV();  // Los historiales de usuario se limpian
+        // Anota la baja en la bitácora; la cascada se repite al reproducirla
+        anotar_bitacora({ "LIBRO_BAJA", isbn });
         
         return true;
     }
 
     // Función para modificar los datos de un libro existente
     bool modificarLibro(const string& isbn, const Libro& nuevo) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return false;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Verifica que el libro original exista
         if (!libros.count(isbn)) {
             return false;
         }
         
-        // Guarda una copia del libro viejo para comparar cambios
-        Libro viejo = libros[isbn];
-        string titulo_anterior = viejo.titulo;
-
-        // Actualiza el libro en el mapa principal con los datos nuevos
-        libros[isbn] = nuevo;
-
-        // Actualiza el índice secundario
-        // Primero busca y borra la entrada antigua en el índice
-        for (auto it = indice.begin(); it != indice.end(); ++it) {
-            if (it->second == isbn) { 
-                indice.erase(it); 
-                break; // Solo debería haber una entrada por libro
-            }
-        }
-        // Inserta la nueva entrada en el índice
-        indice[nuevo.titulo] = isbn;
-        
-        // Re-indexa el nuevo título y autores para la búsqueda
-        indexar_termino(nuevo.titulo, nuevo.isbn); 
-        for (const string& autor : nuevo.autores) {
-            indexar_termino(autor, nuevo.isbn); 
-        }
-
-        // --- CASCADA: Actualizar título en Usuarios y Préstamos si cambió ---
-        if (titulo_anterior != nuevo.titulo) {
-            // 1. Actualizar Préstamos activos (que guardan una copia del título)
-            for (auto& par : prestamos) {
-                if (par.second.isbn == isbn) {
-                    par.second.titulo = nuevo.titulo;
-                }
-            }
-
-            // 2. Actualizar Historial de Usuarios (Aquí es texto plano, hay que buscar y reemplazar)
-            for (auto& par_u : usuarios) {
-                Usuario& u = par_u.second;
-                // Itera por referencia sobre cada título en el historial
-                for (string& t : u.historial_titulos) {
-                    // Si coincide con el título viejo
-                    if (t == titulo_anterior) {
-                        // Lo reemplaza con el nuevo
-                        t = nuevo.titulo;
-                    }
-                }
-            }
-        }
-        // ----------------------------------------------------------
+        // Reemplaza el libro, actualiza índices y propaga el nuevo título
+        aplicarModificacionLibro(isbn, nuevo);
 
-        // Guarda cambios en todos los archivos afectados
-        guardarLibrosCSV();
-        guardarUsuariosCSV(); // Se actualiza por si cambiaron los historiales de títulos
-        guardarPrestamosCSV(); // Se actualiza por si cambió el título en el registro de préstamo
+        // Anota la modificación en la bitácora (ISBN original + datos nuevos)
+        vector<string> registro = campos_libro(nuevo);
+        registro.insert(registro.begin(), { "LIBRO_MOD", isbn });
+        anotar_bitacora(registro);
 
         return true;
     }
@@ -1442,23 +5900,65 @@ public:
     void mostrar_libros_por_isbn_num_ordenado() const {
         cout << "--- Libros ordenados por ISBN numerico (via AVL) ---" << endl;
         
-        // Obtiene el vector ordenado haciendo un recorrido In-Order del AVL
-        vector<pair<long long, string>> isbns_ordenados = isbn_avl.obtenerClavesOrdenadas();
+        // Cursor en la clave más chica: recorre el AVL en orden sin copiarlo
+        AVL::Cursor c = isbn_avl.inicio();
         
-        // Verifica si la lista está vacía
-        if (isbns_ordenados.empty()) { 
+        // Verifica si el árbol está vacío
+        if (!c.valido()) { 
             // Informa al usuario
             cout << "No hay libros con ISBN numerico valido." << endl; 
             return; 
         }
         
-        // Itera sobre el vector ordenado
-        for (const auto& p : isbns_ordenados) {
+        // Avanza clave por clave
+        for (; c.valido(); c.avanzar()) {
             // Imprime el valor numérico de la clave
-            cout << "ISBN Num: " << p.first << endl;
-            // Llama a mostrar_libro usando el string original del ISBN (p.second)
-            mostrar_libro(p.second);
+            cout << "ISBN Num: " << c.clave() << endl;
+            // Llama a mostrar_libro usando el string original del ISBN
+            mostrar_libro(c.isbn());
+        }
+    }
+
+    // Muestra la página 'pagina' (desde 1) de 'tamano' libros del listado por ISBN numérico:
+    // el AVL salta a la primera posición de la página en O(log n) sin recorrer las anteriores
+    void mostrar_pagina_isbn(size_t pagina, size_t tamano) const {
+        size_t total = isbn_avl.size();
+        size_t paginas = tamano ? (total + tamano - 1) / tamano : 0;
+        cout << "--- Libros por ISBN numerico: pagina " << pagina << " de " << paginas << " ---" << endl;
+        if (pagina == 0 || pagina > paginas) {
+            cout << "No existe esa pagina." << endl;
+            return;
+        }
+        AVL::Cursor c = isbn_avl.seleccionar((pagina - 1) * tamano);
+        for (size_t i = 0; i < tamano && c.valido(); ++i, c.avanzar()) {
+            cout << "ISBN Num: " << c.clave() << endl;
+            mostrar_libro(c.isbn());
+        }
+    }
+
+    // Posición (desde 1) del libro en el listado por ISBN numérico, o 0 si no está en el AVL
+    size_t posicionIsbn(const string& isbn) const {
+        auto it = libros.find(isbn);
+        if (it == libros.end() || it->second.isbn_num == 0) {
+            return 0;
+        }
+        AVL::Cursor c = isbn_avl.lower_bound(it->second.isbn_num);
+        if (!c.valido() || c.isbn() != isbn) {
+            return 0;
         }
+        return isbn_avl.posicion(it->second.isbn_num) + 1;
+    }
+
+    // Muestra los libros con ISBN numérico entre 'desde' y 'hasta' (inclusive), en orden
+    void mostrar_libros_por_isbn_rango(long long desde, long long hasta) const {
+        cout << "--- Libros con ISBN numerico entre " << desde << " y " << hasta << " ---" << endl;
+        size_t encontrados = 0;
+        isbn_avl.recorrer_rango(desde, hasta, [&](long long, const string& isbn) {
+            mostrar_libro(isbn);
+            encontrados++;
+            return true;
+        });
+        cout << encontrados << " libros" << endl;
     }
 
     // Función auxiliar para obtener un puntero a un libro (útil para validaciones externas)
@@ -1475,120 +5975,196 @@ public:
         return nullptr;
     }
 
-    // Función de búsqueda flexible por género
-    void mostrar_libros_por_genero(const string& genero) const {
-        // Copia el género de búsqueda para modificarlo (normalización)
-        string genero_busqueda = genero;
-        
-        // Transforma la cadena de búsqueda a minúsculas
-        transform(genero_busqueda.begin(), genero_busqueda.end(), genero_busqueda.begin(),
-            [](unsigned char c) { return tolower(c); });
-            
-        // Elimina caracteres no alfanuméricos de la búsqueda (espacios, símbolos)
-        genero_busqueda.erase(remove_if(genero_busqueda.begin(), genero_busqueda.end(),
-            [](unsigned char c) { return !isalnum(c); }), genero_busqueda.end());
-
-        cout << "--- Libros del género: " << genero << " ---" << endl;
-        
-        // Bandera para saber si encontramos al menos uno
-        bool encontrado = false;
-        
-        // Itera sobre TODOS los libros de la biblioteca (Búsqueda lineal)
+    // Función de búsqueda flexible por género
+    void mostrar_libros_por_genero(const string& genero) const {
+        cout << "--- Libros del género: " << genero << " ---" << endl;
+        
+        // ISBNs encontrados con el índice invertido de géneros
+        vector<string> encontrados = isbnsPorGenero(genero);
+        for (const string& isbn : encontrados) {
+            // Muestra el libro
+            mostrar_libro(isbn);
+        }
+        
+        // Si no hubo ninguno
+        if (encontrados.empty()) {
+            cout << "No se encontraron libros del género " << genero << endl;
+        }
+    }
+
+    // Textos de los ISBNs de una lista de números del catálogo
+    vector<string> catalogo_a_isbns(const vector<uint32_t>& numeros) const {
+        vector<string> textos;
+        textos.reserve(numeros.size());
+        for (uint32_t n : numeros) {
+            textos.push_back(catalogo.isbn[n].texto());
+        }
+        return textos;
+    }
+
+    // ISBNs (en orden de número) de los libros cuyo género contiene 'genero', sin distinguir
+    // mayúsculas ni símbolos. Esto permite búsquedas parciales (ej: "ficcion" encuentra "Ciencia Ficción")
+    vector<string> isbnsPorGenero(const string& genero) const {
+        return catalogo_a_isbns(catalogo.libros_con_genero(normalizar_genero(genero)));
+    }
+
+    // Lo mismo normalizando el género de cada libro del mapa (referencia para el benchmark)
+    vector<string> isbnsPorGeneroMapa(const string& genero) const {
+        string genero_busqueda = normalizar_genero(genero);
+        vector<pair<uint32_t, string>> encontrados;
+        for (const auto& par : libros) {
+            if (normalizar_genero(par.second.genero).find(genero_busqueda) != string::npos) {
+                encontrados.push_back({ isbns.buscar(ClaveIsbn::de(par.first)), par.first });
+            }
+        }
+        // Mismo orden que el índice
+        sort(encontrados.begin(), encontrados.end());
+        vector<string> isbns_genero;
+        for (auto& e : encontrados) {
+            isbns_genero.push_back(std::move(e.second));
+        }
+        return isbns_genero;
+    }
+
+    // --- Consultas sobre el catálogo completo ---
+
+    // Totales de los libros de 'genero' (texto exacto; vacío = todos) publicados entre los
+    // años 'anio_desde' y 'anio_hasta', recorriendo las columnas del catálogo
+    ResumenCatalogo resumenCatalogo(const string& genero, int anio_desde, int anio_hasta) const {
+        uint32_t g = SIN_NUMERO;
+        if (!genero.empty()) {
+            g = catalogo.generos.buscar(genero);
+            // Un género que ningún libro tuvo nunca no tiene número
+            if (g == SIN_NUMERO) {
+                return ResumenCatalogo();
+            }
+        }
+        return catalogo.resumir(g, static_cast<uint32_t>(max(anio_desde, 0)) * 10000,
+                                static_cast<uint32_t>(max(anio_hasta, 0)) * 10000 + 9999);
+    }
+
+    // Lo mismo recorriendo el mapa de libros (referencia para el benchmark)
+    ResumenCatalogo resumenCatalogoMapa(const string& genero, int anio_desde, int anio_hasta) const {
+        ResumenCatalogo r;
+        uint32_t desde = static_cast<uint32_t>(max(anio_desde, 0)) * 10000;
+        uint32_t hasta = static_cast<uint32_t>(max(anio_hasta, 0)) * 10000 + 9999;
         for (const auto& par : libros) {
-            // Obtiene referencia al libro actual
             const Libro& l = par.second;
-            
-            // Copia el género del libro actual para normalizarlo
-            string l_gen = l.genero;
-            
-            // Transforma género del libro a minúsculas
-            transform(l_gen.begin(), l_gen.end(), l_gen.begin(),
-                [](unsigned char c) { return tolower(c); });
-                
-            // Elimina caracteres no alfanuméricos del género del libro
-            l_gen.erase(remove_if(l_gen.begin(), l_gen.end(),
-                [](unsigned char c) { return !isalnum(c); }), l_gen.end());
-            
-            // Verifica si el género buscado es una subcadena del género del libro
-            // Esto permite búsquedas parciales (ej: "ficcion" encuentra "Ciencia Ficción")
-            if (l_gen.find(genero_busqueda) != string::npos) {
-                // Muestra el libro
-                mostrar_libro(l.isbn);
-                // Marca que encontramos algo
-                encontrado = true;
+            uint32_t fecha = empaquetar_fecha(l.fecha_publi);
+            if ((genero.empty() || l.genero == genero) && fecha >= desde && fecha <= hasta) {
+                r.libros++;
+                r.copias_totales += l.copias_totales;
+                r.copias_disponibles += l.copias_disponibles;
             }
         }
-        
-        // Si tras revisar todos no encontramos nada
-        if (!encontrado) {
-            cout << "No se encontraron libros del género " << genero << endl;
+        return r;
+    }
+
+    // ISBNs de los libros publicados entre 'desde' y 'hasta' (AAAAMMDD, inclusive), por fecha
+    vector<string> isbnsPublicadosEntre(uint32_t desde, uint32_t hasta) const {
+        return catalogo_a_isbns(catalogo.publicados_entre(desde, hasta));
+    }
+
+    // ISBNs de los 'cantidad' libros publicados más recientemente
+    vector<string> isbnsMasRecientes(size_t cantidad) const {
+        return catalogo_a_isbns(catalogo.mas_recientes(cantidad));
+    }
+
+    // Libros publicados por año (anios = 1) o por década (anios = 10)
+    string reporteFechas(uint32_t anios) const {
+        ostringstream out;
+        size_t sin_fecha = libros.size() - catalogo.por_fecha.size();
+        for (const auto& par : catalogo.histograma_fechas(max<uint32_t>(anios, 1))) {
+            out << "  " << par.first;
+            if (anios > 1) {
+                out << "-" << par.first + anios - 1;
+            }
+            out << ": " << par.second << " libros\n";
+        }
+        if (sin_fecha > 0) {
+            out << "  (sin fecha): " << sin_fecha << " libros\n";
+        }
+        return out.str();
+    }
+
+    // Inventario por género: libros, copias totales, disponibles y prestadas
+    string reporteInventario() const {
+        vector<ResumenCatalogo> por_genero(catalogo.generos.size());
+        ResumenCatalogo total;
+        for (size_t i = 0; i < catalogo.size(); ++i) {
+            if (!catalogo.vivo[i]) {
+                continue;
+            }
+            ResumenCatalogo& r = por_genero[catalogo.genero[i]];
+            r.libros++;
+            r.copias_totales += catalogo.copias_totales[i];
+            r.copias_disponibles += catalogo.copias_disponibles[i];
+        }
+        // Géneros en orden alfabético
+        vector<pair<string, ResumenCatalogo>> filas;
+        for (size_t g = 0; g < por_genero.size(); ++g) {
+            if (por_genero[g].libros > 0) {
+                filas.push_back({ catalogo.generos.nombre(static_cast<uint32_t>(g)), por_genero[g] });
+                total.libros += por_genero[g].libros;
+                total.copias_totales += por_genero[g].copias_totales;
+                total.copias_disponibles += por_genero[g].copias_disponibles;
+            }
+        }
+        sort(filas.begin(), filas.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        filas.push_back({ "TOTAL", total });
+        ostringstream out;
+        for (const auto& f : filas) {
+            out << "  " << (f.first.empty() ? "(sin genero)" : f.first) << ": " << f.second.libros << " libros, "
+                << f.second.copias_totales << " copias, " << f.second.copias_disponibles << " disponibles, "
+                << f.second.copias_totales - f.second.copias_disponibles << " prestadas\n";
         }
+        return out.str();
     }
     // ----- Usuarios -----
 
     // Función para registrar un nuevo usuario
     bool agregarUsuario(const Usuario& u) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return false;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Verifica si el ID de usuario ya existe
         if (usuarios.count(u.id_usuario)) {
             return false;
         }
         
         // Inserta el usuario en el mapa
-        usuarios[u.id_usuario] = u;
+        aplicarAltaUsuario(u);
         
         // Registra la acción para poder deshacerla
         registrar_accion({ TipoAccion::AgregarUsuario, u.id_usuario, "", "" });
         
-        // Guarda en CSV
-        guardarUsuariosCSV();
+        // Anota el alta en la bitácora
+        anotar_bitacora({ "USUARIO_ALTA", u.id_usuario, u.nombre, u.correo });
         
         return true;
     }
 
     // Función para eliminar un usuario y limpiar sus dependencias
     bool eliminarUsuario(const string& uid) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return false;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Verifica si el usuario existe
         if (!usuarios.count(uid)) {
             return false;
         }
 
-        // Obtiene referencia al usuario
-        Usuario& u = usuarios[uid];
-
-        // 1. Devolver libros que el usuario tenga activos (Recuperar stock para la biblioteca)
-        // Itera sobre los ISBNs que tiene prestados actualmente
-        for (const string& isbn : u.prestamos_activos) {
-            // Si el libro existe en la base de datos
-            if (libros.count(isbn)) {
-                // Incrementa las copias disponibles (como si los devolviera forzosamente)
-                libros[isbn].copias_disponibles++;
-            }
-        }
-
-        // 2. Eliminar PRÉSTAMOS asociados a este usuario en el archivo de prestamos
-        // Vector para recolectar IDs de préstamos a borrar
-        vector<string> prestamos_a_borrar;
-        
-        // Busca en todos los préstamos
-        for (auto& par : prestamos) {
-            // Si el préstamo pertenece al usuario a eliminar
-            if (par.second.id_usuario == uid) {
-                prestamos_a_borrar.push_back(par.first);
-            }
-        }
-        
-        // Borra los préstamos encontrados
-        for (const string& pid : prestamos_a_borrar) {
-            prestamos.erase(pid);
-        }
-
-        // 3. Eliminar usuario del mapa principal
-        usuarios.erase(uid);
+        // Recupera el stock prestado, borra sus préstamos y lo elimina del mapa
+        aplicarBajaUsuario(uid);
 
-        // 4. GUARDAR TODO
-        guardarUsuariosCSV();    // Elimina al usuario del archivo
-        guardarLibrosCSV();      // Guarda el stock actualizado (libros recuperados)
-        guardarPrestamosCSV();   // Elimina los registros de préstamo
+        // Anota la baja en la bitácora
+        anotar_bitacora({ "USUARIO_BAJA", uid });
         
         return true;
     }
@@ -1596,8 +6172,15 @@ public:
     // ----- Préstamos / Devoluciones -----
 
     // Función principal para procesar el préstamo de un libro
-    // Retorna: 1 (Éxito), 2 (En cola), 0 (Libro no existe), -1 (Usuario no existe)
+    // Retorna: 1 (Éxito), 2 (En cola), 0 (Libro no existe), -1 (Usuario no existe),
+    // -2 (cola de escritura llena, no se aplicó)
     int prestamoLibro(const string& id_usuario, const string& isbn) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return -2;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Validación: Usuario no existe
         if (!usuarios.count(id_usuario)) {
             return -1; 
@@ -1607,52 +6190,19 @@ public:
             return 0;          
         }
 
-        // Obtiene referencia al libro
-        Libro& l = libros[isbn];
-
         // CASO 1: Hay copias disponibles -> Prestar inmediatamente
-        if (l.copias_disponibles > 0) {
-            // Reduce el inventario disponible
-            l.copias_disponibles -= 1;
-            
-            // Registra el libro en los préstamos activos del usuario
-            usuarios[id_usuario].prestamos_activos.insert(isbn);
-            
-            // Lo añade al historial general de lecturas
-            usuarios[id_usuario].historial_isbn.push_back(isbn);
+        if (libros[isbn].copias_disponibles > 0) {
+            // Genera el ID aquí para que la bitácora lo reproduzca idéntico
+            string pid = generar_id_prestamo();
             
-            // Incrementa contador de préstamos
-            usuarios[id_usuario].num_prestamos_activos++;
-
-            // --- Actualizar GRAFO de conexiones (para recomendaciones) ---
-            // Conecta este nuevo libro con todos los libros previos del historial del usuario
-            for (const string& otro : usuarios[id_usuario].historial_isbn) {
-                // Evita conectarse consigo mismo
-                if (otro == isbn) {
-                    continue;
-                }
-                // Incrementa peso bidireccional
-                grafico_libro[isbn][otro] += 1;
-                grafico_libro[otro][isbn] += 1;
-            }
-
-            // Crear objeto Préstamo
-            Prestamo P;
-            P.id_prestamo = generar_id_prestamo();
-            P.isbn = isbn;
-            P.id_usuario = id_usuario;
-            P.activo = true;
-            
-            // Guardar préstamo en el mapa
-            prestamos[P.id_prestamo] = P;
+            // Descuenta la copia, actualiza al usuario y al grafo, y crea el préstamo
+            aplicarPrestamo(pid, id_usuario, isbn);
 
             // Registrar acción para Undo
-            registrar_accion({ TipoAccion::PrestarLibro, P.id_prestamo, id_usuario, isbn });
+            registrar_accion({ TipoAccion::PrestarLibro, pid, id_usuario, isbn });
 
-            // Guardar cambios en todos los archivos
-            guardarLibrosCSV();
-            guardarPrestamosCSV();
-            guardarUsuariosCSV();
+            // Un solo registro en la bitácora en lugar de reescribir tres CSV
+            anotar_bitacora({ "PRESTAMO", pid, id_usuario, isbn });
             
             return 1; // Código de ÉXITO
         }
@@ -1660,13 +6210,13 @@ public:
         // CASO 2: No hay copias -> Añadir a Cola de espera
         else {
             // Añade el ID del usuario a la cola de ese ISBN
-            lista_espera[isbn].push(id_usuario);
+            aplicarEnCola(isbn, id_usuario);
             
             // Registra acción (para poder sacarlo de la cola si se deshace)
             registrar_accion({ TipoAccion::PonerenCola, isbn, id_usuario, "" });
             
-            // Actualiza archivo de cola
-            guardarListaEsperaCSV(); 
+            // Anota la entrada en cola
+            anotar_bitacora({ "COLA", isbn, id_usuario });
             
             return 2; // Código de EN COLA
         }
@@ -1674,95 +6224,43 @@ public:
 
     // Función para procesar la devolución de un libro
     bool devolver_libro(const string& id_usuario, const string& isbn) {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            return false;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Validaciones básicas de existencia
         if (!usuarios.count(id_usuario) || !libros.count(isbn)) {
             return false;
         }
 
-        // 1. Buscar y desactivar el préstamo actual
-        string pid_actual = "";
-        
-        // Busca el préstamo activo específico para este usuario y libro
-        for (auto& p : prestamos) {
-            // Coincidencia de ISBN, Usuario y que esté Activo
-            if (p.second.isbn == isbn && p.second.id_usuario == id_usuario && p.second.activo) {
-                pid_actual = p.first;
-                break; // Encontrado
-            }
-        }
+        // 1. Buscar el préstamo activo específico para este usuario y libro (índice, sin recorrer préstamos)
+        string pid_actual = buscar_prestamo_activo(id_usuario, isbn);
         
         // Si no se encontró un préstamo activo correspondiente
         if (pid_actual.empty()) {
             return false;
         }
 
-        // Marca el préstamo como inactivo (finalizado)
-        prestamos[pid_actual].activo = false;
-        
-        // Lo quita de la lista de activos del usuario
-        usuarios[id_usuario].prestamos_activos.erase(isbn);
-        
-        // Decrementa contador
-        if (usuarios[id_usuario].num_prestamos_activos > 0) {
-            usuarios[id_usuario].num_prestamos_activos--;
-        }
-        
-        // Guarda el título en el historial de títulos (para persistencia visual)
-        usuarios[id_usuario].historial_titulos.push_back(libros[isbn].titulo);
+        // 2. Si alguien espera el libro, su préstamo automático necesita un ID nuevo
+        auto it_cola = lista_espera.find(isbns.buscar(ClaveIsbn::de(isbn)));
+        string pid_siguiente = it_cola == lista_espera.end() || it_cola->second.empty() ? "" : generar_id_prestamo();
+
+        // Cierra el préstamo y entrega el libro al siguiente de la cola (o lo devuelve al estante)
+        string fecha = fecha_actual();
+        string siguiente_usuario = aplicarDevolucion(id_usuario, isbn, pid_actual, pid_siguiente, fecha);
 
         // Registra acción de devolución
         registrar_accion({ TipoAccion::DevolverLibro, pid_actual, id_usuario, isbn });
 
-        // 2. VERIFICAR COLA DE ESPERA (Lógica automática)
-        if (!lista_espera[isbn].empty()) {
-            // A. Sacar al siguiente usuario de la fila
-            string siguiente_usuario = lista_espera[isbn].front();
-            lista_espera[isbn].pop();
-
-            // B. Crear préstamo automático para él 
-            // IMPORTANTE: No incrementamos 'copias_disponibles' porque el libro pasa de una mano a otra inmediatamente.
-            
-            if (usuarios.count(siguiente_usuario)) {
-                Usuario& u_next = usuarios[siguiente_usuario];
-                
-                // Actualiza datos del nuevo usuario
-                u_next.prestamos_activos.insert(isbn);
-                u_next.historial_isbn.push_back(isbn);
-                u_next.num_prestamos_activos++;
-                
-                // Actualiza grafo para el nuevo usuario
-                for (const string& otro : u_next.historial_isbn) {
-                    if (otro == isbn) {
-                        continue;
-                    }
-                    grafico_libro[isbn][otro] += 1;
-                    grafico_libro[otro][isbn] += 1;
-                }
-
-                // Genera el nuevo registro de préstamo
-                Prestamo P;
-                P.id_prestamo = generar_id_prestamo();
-                P.isbn = isbn;
-                P.id_usuario = siguiente_usuario;
-                P.activo = true;
-                prestamos[P.id_prestamo] = P;
-                
-                // Nota: No registramos acción de "Prestar" aquí en el historial de deshacer 
-                // para mantener simple el flujo de Undo de la devolución original.
-            }
-            // Notificación en consola
+        // Notificación en consola si el libro pasó a la lista de espera
+        if (!siguiente_usuario.empty()) {
             cout << ">>> AVISO: El libro ha sido asignado automáticamente a " << siguiente_usuario << " de la lista de espera." << endl;
-        } 
-        else {
-            // Si nadie espera, el libro vuelve al estante
-            libros[isbn].copias_disponibles += 1;
         }
 
-        // 3. ACTUALIZAR TODOS LOS CSV
-        guardarLibrosCSV();        // Stock
-        guardarPrestamosCSV();     // Estado de préstamos
-        guardarUsuariosCSV();      // Historiales
-        guardarListaEsperaCSV();   // Cola
+        // 3. Un solo registro en la bitácora en lugar de reescribir los cuatro CSV
+        anotar_bitacora({ "DEVOLUCION", id_usuario, isbn, pid_actual, pid_siguiente, fecha });
 
         return true;
     }
@@ -1780,25 +6278,32 @@ public:
             return res;
         }
         
-        // 2. Preparar estructuras auxiliares
+        // 2. Preparar estructuras auxiliares (todo por número de ISBN)
         // Mapa para acumular puntos de recomendación para cada libro candidato
-        unordered_map<string, int> scores;
+        unordered_map<uint32_t, int> scores;
         
-        // Conjunto para acceso rápido a los libros que el usuario YA leyó
-        // (para no recomendarle algo que ya conoce)
-        unordered_set<string> leidos(usuarios[id_usuario].historial_isbn.begin(), usuarios[id_usuario].historial_isbn.end());
+        // Números de los libros que el usuario YA leyó, para acceso rápido
+        // (para no recomendarle algo que ya conoce; un ISBN sin número no está en el grafo)
+        vector<uint32_t> historial;
+        for (ClaveIsbn isbn_leido : usuarios[id_usuario].historial_isbn) {
+            uint32_t n = isbns.buscar(isbn_leido);
+            if (n != SIN_NUMERO) {
+                historial.push_back(n);
+            }
+        }
+        unordered_set<uint32_t> leidos(historial.begin(), historial.end());
         
         // 3. BARRIDO DEL GRAFO (Algoritmo Colaborativo)
         // Recorre cada libro en el historial de lectura del usuario objetivo
-        for (const string& isbn_leido : usuarios[id_usuario].historial_isbn) {
+        for (uint32_t n_leido : historial) {
             
             // Verifica si este libro tiene conexiones en el grafo (alguien más lo leyó junto con otros)
-            if (grafico_libro.count(isbn_leido)) {
+            if (n_leido < grafico_libro.size()) {
                 
                 // Itera sobre todos los "vecinos" (libros conectados) en el grafo
-                for (auto& par_vecino : grafico_libro[isbn_leido]) {
-                    // Obtiene el ISBN del libro vecino (candidato a recomendación)
-                    const string& isbn_candidato = par_vecino.first;
+                for (auto& par_vecino : grafico_libro[n_leido]) {
+                    // Obtiene el número del libro vecino (candidato a recomendación)
+                    uint32_t isbn_candidato = par_vecino.first;
                     // Obtiene el peso de la conexión (cuántas veces han sido leídos juntos)
                     int peso_conexion = par_vecino.second;
                     
@@ -1816,8 +6321,8 @@ public:
 
         // 4. Pasar del mapa de puntuaciones al vector de resultados para poder ordenar
         for (auto& p : scores) {
-            // Empuja el par (ISBN, Score) al vector
-            res.push_back({ p.first, p.second });
+            // Empuja el par (ISBN, Score) al vector (el número vuelve a ser ISBN)
+            res.push_back({ isbns.nombre(p.first).texto(), p.second });
         }
 
         // 5. Ordenar por relevancia (Mayor puntaje primero)
@@ -1860,61 +6365,79 @@ public:
             c = tolower(static_cast<unsigned char>(c));
         }
 
-        // 3. Usar el Trie para obtener terminaciones posibles
-        // Busca en el árbol todas las palabras que completan el prefijo dado
-        vector<string> coincidencias_trie = trie.buscarPrefijo(p_low);
-
-        // 4. Recuperar títulos reales a partir de las coincidencias del Trie
+        // 3. Recuperar títulos reales a partir de las palabras del Trie
         // Contador para limitar resultados a K
         int contador = 0;
         // Conjunto para evitar duplicados en la lista de resultados
-        unordered_set<string> isbns_vistos; 
+        unordered_set<uint32_t> isbns_vistos; 
 
-        // Itera sobre cada palabra encontrada en el Trie (títulos o autores normalizados)
-        for (const string& llave : coincidencias_trie) {
-            
+        // Agrega los libros de una palabra (título o autor normalizado); devuelve true al llegar a K
+        auto agregar_libros = [&](const string& llave) {
             // Busca la llave en el mapa inverso (Texto normalizado -> Lista de ISBNs)
             // Usamos find() para evitar crear entradas vacías accidentalmente con []
             auto it_mapa = mapa_busqueda.find(llave);
             
-            // Si la llave existe en el mapa
-            if (it_mapa != mapa_busqueda.end()) {
+            // Si la llave no existe en el mapa no aporta nada
+            if (it_mapa == mapa_busqueda.end()) {
+                return false;
+            }
                 
-                // Itera sobre todos los ISBNs asociados a esa palabra clave
-                for (const string& isbn : it_mapa->second) {
-                    
-                    // Si ya agregamos este libro a la lista de resultados, lo saltamos
-                    if (isbns_vistos.count(isbn)) {
-                        continue;
-                    }
-                    
-                    // Verificar que el libro siga existiendo (pudo ser borrado de la biblioteca)
-                    auto it_libro = libros.find(isbn);
+            // Itera sobre todos los ISBNs asociados a esa palabra clave
+            for (uint32_t n_libro : it_mapa->second) {
+                
+                // Si ya agregamos este libro a la lista de resultados, lo saltamos
+                if (isbns_vistos.count(n_libro)) {
+                    continue;
+                }
+                
+                // Verificar que el libro siga existiendo (pudo ser borrado de la biblioteca)
+                auto it_libro = libros.find(isbns.nombre(n_libro).texto());
+                
+                // Si el libro existe
+                if (it_libro != libros.end()) {
+                    // Referencia al libro
+                    const Libro& l = it_libro->second;
                     
-                    // Si el libro existe
-                    if (it_libro != libros.end()) {
-                        // Referencia al libro
-                        const Libro& l = it_libro->second;
-                        
-                        // Construir string de presentación: Título + Autores
-                        string autores_str = join(l.autores, ", ");
-                        string display = l.titulo + " (Autor: " + autores_str + ")";
-                        
-                        // Añade a la lista de resultados
-                        sugerencias_finales.push_back(display);
-                        // Marca el ISBN como visto
-                        isbns_vistos.insert(isbn);
-                        // Incrementa contador
-                        contador++;
-                    }
+                    // Construir string de presentación: Título + Autores
+                    string autores_str = join(l.autores, ", ");
+                    string display = l.titulo + " (Autor: " + autores_str + ")";
                     
-                    // Si alcanzamos el límite K, terminamos la búsqueda
-                    if (contador >= K) {
-                        return sugerencias_finales;
-                    }
+                    // Añade a la lista de resultados
+                    sugerencias_finales.push_back(display);
+                    // Marca el ISBN como visto
+                    isbns_vistos.insert(n_libro);
+                    // Incrementa contador
+                    contador++;
+                }
+                
+                // Si alcanzamos el límite K, terminamos la búsqueda
+                if (contador >= K) {
+                    return true;
                 }
             }
+            return false;
+        };
+
+        // 4. Primero las palabras más leídas: el Trie guarda las mejores de cada prefijo, así
+        // que no hace falta recorrer todo lo que cuelga de él
+        size_t pedidas = min(static_cast<size_t>(max(K, 0)), Trie::K_MEJORES);
+        vector<string> mejores = trie.mejoresPrefijo(p_low, pedidas);
+        for (const string& llave : mejores) {
+            if (agregar_libros(llave)) {
+                return sugerencias_finales;
+            }
+        }
+
+        // 5. Si vinieron menos palabras que las pedidas ya no hay más. Si no, y faltan libros
+        // (un libro que aparece por título y por autor, o K mayor que K_MEJORES), se completa
+        // con el resto de las palabras del prefijo en orden alfabético
+        if (mejores.size() < pedidas || contador >= K) {
+            return sugerencias_finales;
         }
+        // El recorrido del Trie corta apenas se juntan K libros
+        trie.recorrerPrefijo(p_low, SIZE_MAX, [&](const string& llave) {
+            return !agregar_libros(llave);
+        });
         // Retorna las sugerencias encontradas
         return sugerencias_finales;
     }
@@ -1946,8 +6469,8 @@ public:
         } 
         else {
             // Itera sobre el conjunto de préstamos activos
-            for (const string& isbn : u.prestamos_activos) {
-                cout << isbn << " ";
+            for (ClaveIsbn isbn : u.prestamos_activos) {
+                cout << isbn.texto() << " ";
             }
         }
         
@@ -1960,7 +6483,8 @@ public:
         } 
         else {
             // Itera sobre el historial de ISBNs
-            for (const string& isbn : u.historial_isbn) {
+            for (ClaveIsbn clave : u.historial_isbn) {
+                string isbn = clave.texto();
                 // Verificación doble para evitar crashes si el libro fue borrado de la BD
                 auto it_libro = libros.find(isbn);
                 
@@ -1982,7 +6506,8 @@ public:
     void mostrar_titulos_ordenados() {
         cout << "\nTitulos ordenados: \n" << endl;
         
-        // Itera sobre el mapa 'indice' que, al ser un std::map, mantiene las claves (títulos) ordenadas
+        // Itera sobre el índice 'indice' que, al ser un std::set, mantiene los pares (título, ISBN)
+        // ordenados; las ediciones con el mismo título aparecen todas, por ISBN
         for (auto& p : indice) {
             // Imprime Título (p.first) e ISBN (p.second)
             cout << p.first << " (" << p.second << ")" << endl;
@@ -1991,6 +6516,13 @@ public:
 
     // Función pública para deshacer la última acción registrada
     void deshacerUltimaOperacion() {
+        // Reserva lugar en la cola de escritura antes de bloquear la memoria
+        ReservaEscritura reserva = reservar_escritura();
+        if (!reserva) {
+            cout << "Cola de escritura llena: intente deshacer de nuevo en un momento." << endl;
+            return;
+        }
+        lock_guard<mutex> lk(mutex_estado);
         // Verifica si la pila de acciones está vacía
         if (historial_acciones.empty()) {
             cout << "No hay acciones para deshacer." << endl;
@@ -2008,13 +6540,568 @@ public:
     }
 };
 
+// ------------------ Benchmarks -----------------
+
+// Genera un conjunto sintético de CSV en 'dir': n libros, n/2 usuarios con 5 lecturas cada uno
+void generar_datos_sinteticos(const string& dir, size_t n_libros) {
+    // Géneros de ejemplo
+    const vector<string> generos = { "Ficcion", "Misterio", "Ciencia ficcion", "Drama", "Fantasia", "Historia" };
+    // Generador determinista para que cada ejecución use los mismos datos
+    mt19937 gen(12345);
+    
+    // Libros con ISBN 978 + 10 dígitos consecutivos
+    vector<string> isbns(n_libros);
+    ofstream fl(dir + "libros.csv");
+    fl << "isbn,titulo,autores,genero,fecha_publi,copias_totales,copias_disponibles\n";
+    for (size_t i = 0; i < n_libros; ++i) {
+        string num = to_string(i);
+        isbns[i] = "978" + string(10 - num.size(), '0') + num;
+        // Uno de cada diez títulos lleva coma y queda entre comillas, como en el CSV real
+        fl << isbns[i] << (i % 10 ? ",Titulo " : ",\"Titulo ") << i << (i % 10 ? "" : ", tomo 2\"")
+           << ",Autor " << (i % 5000) << "^Coautor " << (i % 97) << ","
+           << generos[i % generos.size()] << "," << (1900 + i % 120) << "-01-01,10,10\n";
+    }
+    
+    // Usuarios y préstamos cerrados (5 por usuario, repartidos en los segmentos de 2024 del archivo)
+    ofstream fu(dir + "usuarios.csv");
+    ofstream fp(dir + "prestamos.csv");
+    fu << "id_usuario,nombre,correo,prestamos_activos,historial_isbn,historial_titulos_lectura\n";
+    fp << "id_prestamo,isbn,id_usuario,nombre_usuario,titulo,activo\n";
+    filesystem::create_directories(dir + "archivo_prestamos");
+    vector<ofstream> segmentos;
+    for (int mes = 1; mes <= 12; ++mes) {
+        segmentos.emplace_back(dir + "archivo_prestamos/prestamos_2024-" + (mes < 10 ? "0" : "") + to_string(mes) + ".csv");
+        segmentos.back() << "id_prestamo,isbn,id_usuario,nombre_usuario,titulo,fecha_cierre\n";
+    }
+    size_t n_usuarios = max<size_t>(1, n_libros / 2);
+    uniform_int_distribution<size_t> elegir(0, n_libros - 1);
+    for (size_t u = 0; u < n_usuarios; ++u) {
+        string num = to_string(u);
+        string id = string(12 - num.size(), '0') + num;
+        vector<string> hist;
+        for (int k = 0; k < 5; ++k) {
+            hist.push_back(isbns[elegir(gen)]);
+            size_t mes = (u * 5 + k) % 12;
+            segmentos[mes] << "P" << u << "_" << k << "," << hist.back() << "," << id << ",Usuario " << u
+                           << ",,2024-" << (mes < 9 ? "0" : "") << mes + 1 << "-15\n";
+        }
+        fu << id << ",Usuario " << u << ",u" << u << "@correo.com,,";
+        for (int k = 0; k < 5; ++k) {
+            fu << (k ? "^" : "") << hist[k];
+        }
+        fu << ",\n";
+    }
+    
+    // Lista de espera vacía
+    ofstream fe(dir + "lista_espera.csv");
+    fe << "isbn,cola_usuarios\n";
+}
+
+// Compara el tiempo de arranque desde CSV y desde la instantánea binaria
+int benchmark_carga(size_t n_libros) {
+    // Directorio de trabajo propio para no tocar los datos reales
+    const string dir = "bench_carga/";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    generar_datos_sinteticos(dir, n_libros);
+    
+    // Silencia los mensajes de carga mientras se mide
+    ostringstream nulo;
+    streambuf* cout_original = cout.rdbuf(nulo.rdbuf());
+    
+    // Referencia: arranque desde CSV con un solo hilo (mejor de 3)
+    size_t hilos = hilos_de_carga();
+    size_t hilos_originales = hilos_carga_configurados;
+    hilos_carga_configurados = 1;
+    double csv1_tablas = 1e18, csv1_total = 1e18;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto t0 = chrono::steady_clock::now();
+        Biblioteca b(false, dir);
+        csv1_total = min(csv1_total, chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+        csv1_tablas = min(csv1_tablas, b.tiempoCargaTablasMs());
+    }
+    hilos_carga_configurados = hilos_originales;
+    
+    // Mejor de 3 arranques para cada formato (tablas y arranque completo con el grafo)
+    double csv_tablas = 1e18, csv_total = 1e18, snap_tablas = 1e18, snap_total = 1e18;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto t0 = chrono::steady_clock::now();
+        Biblioteca b(false, dir);
+        csv_total = min(csv_total, chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+        csv_tablas = min(csv_tablas, b.tiempoCargaTablasMs());
+        // La primera vuelta deja escrita la instantánea para las siguientes mediciones
+        if (rep == 0) {
+            b.escribirSnapshot();
+        }
+    }
+    // Guardado de usuarios.csv: la primera vez arma todas las líneas, después las reutiliza
+    double usuarios_frio = 0, usuarios_cache = 1e18;
+    {
+        Biblioteca b(false, dir);
+        usuarios_frio = b.tiempoSerializarUsuariosMs();
+        for (int rep = 0; rep < 3; ++rep) {
+            usuarios_cache = min(usuarios_cache, b.tiempoSerializarUsuariosMs());
+        }
+    }
+    for (int rep = 0; rep < 3; ++rep) {
+        auto t0 = chrono::steady_clock::now();
+        Biblioteca b(true, dir);
+        snap_total = min(snap_total, chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+        snap_tablas = min(snap_tablas, b.tiempoCargaTablasMs());
+    }
+    cout.rdbuf(cout_original);
+    
+    // Tamaños en disco de ambos formatos
+    uintmax_t bytes_csv = 0;
+    for (const char* f : { "libros.csv", "usuarios.csv", "prestamos.csv", "lista_espera.csv" }) {
+        bytes_csv += filesystem::file_size(dir + f);
+    }
+    uintmax_t bytes_snap = filesystem::file_size(dir + "biblioteca.snap");
+    
+    // Reporte
+    cout << "Arranque con " << n_libros << " libros, " << max<size_t>(1, n_libros / 2) << " usuarios, "
+         << 5 * max<size_t>(1, n_libros / 2) << " prestamos cerrados en el archivo (mejor de 3)\n";
+    cout << "  CSV 1 hilo : tablas " << csv1_tablas << " ms, total " << csv1_total << " ms\n";
+    cout << "  CSV " << hilos << " hilos: tablas " << csv_tablas << " ms, total " << csv_total << " ms, " << bytes_csv << " bytes\n";
+    cout << "  Instantanea: tablas " << snap_tablas << " ms, total " << snap_total << " ms, " << bytes_snap << " bytes\n";
+    cout << "  Aceleracion de lectura de tablas: " << (snap_tablas > 0 ? csv_tablas / snap_tablas : 0) << "x\n";
+    cout << "  Serializar usuarios.csv: " << usuarios_frio << " ms sin cache, " << usuarios_cache << " ms con las lineas en cache" << endl;
+    filesystem::remove_all(dir);
+    return 0;
+}
+
+// Mide el rendimiento (MB/s) del tokenizador CSV con cada variante de escaneo
+int benchmark_csv(size_t n_libros) {
+    const string dir = "bench_csv/";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    generar_datos_sinteticos(dir, n_libros);
+    
+    // Variantes a comparar (las no soportadas por la CPU se omiten)
+    vector<ModoEscaneo> modos = { ESCANEO_ESCALAR };
+#ifdef BIBLIOTECA_SIMD_X86
+    modos.push_back(ESCANEO_SSE2);
+    if (mejor_modo_escaneo() == ESCANEO_AVX2) {
+        modos.push_back(ESCANEO_AVX2);
+    }
+#endif
+    
+    cout << "Tokenizador CSV con " << n_libros << " libros sinteticos (mejor de 5)\n";
+    for (const char* archivo : { "libros.csv", "usuarios.csv" }) {
+        // Texto original (cada repetición parte de una copia porque el lector quita comillas en su lugar)
+        LectorCSV original;
+        original.abrir(dir + archivo, ',');
+        double mb = original.buffer.size() / (1024.0 * 1024.0);
+        cout << "  " << archivo << " (" << mb << " MB)\n";
+        
+        double ms_escalar = 0;
+        size_t suma_referencia = 0;
+        for (ModoEscaneo modo : modos) {
+            double mejor = 1e18;
+            size_t suma = 0;
+            for (int rep = 0; rep < 5; ++rep) {
+                LectorCSV lector;
+                lector.cargar(original.buffer, ',');
+                lector.escanear = funcion_escaneo(modo);
+                vector<string_view> campos;
+                // Suma de campos y longitudes para comprobar que todas las variantes coinciden
+                suma = 0;
+                auto t0 = chrono::steady_clock::now();
+                while (lector.siguiente_fila(campos)) {
+                    for (string_view c : campos) {
+                        suma += c.size() + 1;
+                    }
+                }
+                mejor = min(mejor, chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+            }
+            if (modo == ESCANEO_ESCALAR) {
+                ms_escalar = mejor;
+                suma_referencia = suma;
+            }
+            cout << "    " << nombre_modo_escaneo(modo) << ": " << mejor << " ms, "
+                 << (mejor > 0 ? mb * 1000.0 / mejor : 0) << " MB/s";
+            if (modo != ESCANEO_ESCALAR) {
+                cout << ", " << (mejor > 0 ? ms_escalar / mejor : 0) << "x";
+            }
+            cout << (suma == suma_referencia ? "" : "  [DIFERENCIA EN LOS CAMPOS]") << "\n";
+        }
+    }
+    filesystem::remove_all(dir);
+    return 0;
+}
+
+// Compara las consultas de recorrido completo sobre el mapa de libros y sobre el catálogo en columnas
+int benchmark_catalogo(size_t n_libros) {
+    const string dir = "bench_catalogo/";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    generar_datos_sinteticos(dir, n_libros);
+    
+    // Silencia los mensajes de carga
+    ostringstream nulo;
+    streambuf* cout_original = cout.rdbuf(nulo.rdbuf());
+    Biblioteca b(false, dir);
+    cout.rdbuf(cout_original);
+    
+    // Consultas: un género, todo el catálogo y un rango de años
+    struct Consulta { const char* nombre; string genero; int desde, hasta; };
+    const vector<Consulta> consultas = {
+        { "filtro por genero", "Drama", 0, 9999 },
+        { "totales de copias", "", 0, 9999 },
+        { "rango de fechas", "", 1950, 1969 },
+    };
+    
+    cout << "Consultas de recorrido con " << n_libros << " libros sinteticos (mejor de 5)\n";
+    for (const Consulta& c : consultas) {
+        double ms_mapa = 1e18, ms_columnas = 1e18;
+        ResumenCatalogo r_mapa, r_columnas;
+        for (int rep = 0; rep < 5; ++rep) {
+            auto t0 = chrono::steady_clock::now();
+            r_mapa = b.resumenCatalogoMapa(c.genero, c.desde, c.hasta);
+            auto t1 = chrono::steady_clock::now();
+            r_columnas = b.resumenCatalogo(c.genero, c.desde, c.hasta);
+            auto t2 = chrono::steady_clock::now();
+            ms_mapa = min(ms_mapa, chrono::duration<double, milli>(t1 - t0).count());
+            ms_columnas = min(ms_columnas, chrono::duration<double, milli>(t2 - t1).count());
+        }
+        cout << "  " << c.nombre << ": " << r_columnas.libros << " libros, " << r_columnas.copias_disponibles
+             << " copias disponibles; mapa " << ms_mapa << " ms, columnas " << ms_columnas << " ms, "
+             << (ms_columnas > 0 ? ms_mapa / ms_columnas : 0) << "x"
+             << (r_mapa == r_columnas ? "" : "  [DIFERENCIA EN LOS RESULTADOS]") << "\n";
+    }
+    
+    // Búsqueda parcial por género (menú 15): normalizar cada libro vs índice invertido de géneros
+    for (const char* busqueda : { "ficcion", "Misterio" }) {
+        double ms_mapa = 1e18, ms_indice = 1e18;
+        vector<string> v_mapa, v_indice;
+        for (int rep = 0; rep < 5; ++rep) {
+            auto t0 = chrono::steady_clock::now();
+            v_mapa = b.isbnsPorGeneroMapa(busqueda);
+            auto t1 = chrono::steady_clock::now();
+            v_indice = b.isbnsPorGenero(busqueda);
+            auto t2 = chrono::steady_clock::now();
+            ms_mapa = min(ms_mapa, chrono::duration<double, milli>(t1 - t0).count());
+            ms_indice = min(ms_indice, chrono::duration<double, milli>(t2 - t1).count());
+        }
+        cout << "  genero \"" << busqueda << "\": " << v_indice.size() << " libros; recorrido " << ms_mapa
+             << " ms, indice " << ms_indice << " ms, " << (ms_indice > 0 ? ms_mapa / ms_indice : 0) << "x"
+             << (v_mapa == v_indice ? "" : "  [DIFERENCIA EN LOS RESULTADOS]") << "\n";
+    }
+    
+    // Rango de fechas angosto: recorrido de las columnas vs índice ordenado de fechas
+    {
+        double ms_columnas = 1e18, ms_indice = 1e18;
+        size_t en_columnas = 0, en_indice = 0;
+        for (int rep = 0; rep < 5; ++rep) {
+            auto t0 = chrono::steady_clock::now();
+            en_columnas = b.resumenCatalogo("", 1950, 1951).libros;
+            auto t1 = chrono::steady_clock::now();
+            en_indice = b.isbnsPublicadosEntre(limite_fecha("1950", false), limite_fecha("1951", true)).size();
+            auto t2 = chrono::steady_clock::now();
+            ms_columnas = min(ms_columnas, chrono::duration<double, milli>(t1 - t0).count());
+            ms_indice = min(ms_indice, chrono::duration<double, milli>(t2 - t1).count());
+        }
+        cout << "  publicados 1950-1951: " << en_indice << " libros; columnas " << ms_columnas << " ms, indice de fechas "
+             << ms_indice << " ms, " << (ms_indice > 0 ? ms_columnas / ms_indice : 0) << "x"
+             << (en_columnas == en_indice ? "" : "  [DIFERENCIA EN LOS RESULTADOS]") << "\n";
+    }
+    filesystem::remove_all(dir);
+    return 0;
+}
+
+// Mide un índice por ISBN numérico (AVL o árbol B+) con las claves de 'claves' en orden
+// aleatorio: inserción de todas, búsquedas puntuales (la mitad fallidas), recorrido en orden
+// completo y borrado de una de cada diez. 'control' acumula resultados para comparar los índices
+template <typename Indice>
+void medir_indice(const char* nombre, const vector<pair<long long, string>>& claves, size_t consultas, unsigned long long& control) {
+    auto medir = [](auto f) {
+        auto t0 = chrono::steady_clock::now();
+        f();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    };
+    Indice indice;
+    double ms_insertar = medir([&] {
+        for (const auto& c : claves) {
+            indice.insertar(c.first, c.second);
+        }
+    });
+    // Claves a buscar, elegidas antes de medir (son pares: sumar 1 da una búsqueda fallida)
+    mt19937 gen(7);
+    uniform_int_distribution<size_t> elegir(0, claves.size() - 1);
+    vector<long long> buscadas(consultas);
+    for (size_t q = 0; q < consultas; ++q) {
+        buscadas[q] = claves[elegir(gen)].first + static_cast<long long>(q & 1);
+    }
+    size_t encontradas = 0;
+    double ms_buscar = medir([&] {
+        for (long long k : buscadas) {
+            encontradas += indice.buscar(k) != nullptr;
+        }
+    });
+    unsigned long long suma = 0;
+    size_t recorridas = 0;
+    double ms_recorrer = medir([&] {
+        indice.recorrer_rango(INT64_MIN, INT64_MAX, [&](long long k, const string& isbn) {
+            suma += static_cast<unsigned long long>(k) + isbn.size();
+            recorridas++;
+            return true;
+        });
+    });
+    double ms_quitar = medir([&] {
+        for (size_t i = 0; i < claves.size(); i += 10) {
+            indice.quitar(claves[i].first, claves[i].second);
+        }
+    });
+    control = suma ^ (encontradas * 1000003ULL) ^ (recorridas * 7919ULL) ^ indice.size();
+    cout << "    " << nombre << ": insertar " << ms_insertar << " ms, " << consultas << " busquedas " << ms_buscar
+         << " ms, recorrido " << ms_recorrer << " ms, borrar " << claves.size() / 10 << " " << ms_quitar << " ms\n";
+}
+
+// Compara el AVL de ISBNs con el árbol B+ para cada cantidad de claves de 'tamanos'
+int benchmark_indices(const vector<size_t>& tamanos) {
+    for (size_t n : tamanos) {
+        // ISBN-13 sintéticos distintos (pares, para que clave + 1 no esté), en orden aleatorio
+        vector<pair<long long, string>> claves(n);
+        for (size_t i = 0; i < n; ++i) {
+            long long k = 9780000000000LL + 2 * static_cast<long long>(i);
+            claves[i] = { k, to_string(k) };
+        }
+        shuffle(claves.begin(), claves.end(), mt19937(12345));
+        size_t consultas = 1000000;
+        cout << "Indice por ISBN con " << n << " claves\n";
+        // Uno a la vez para no tener ambos árboles en memoria
+        unsigned long long control_avl = 0, control_bmas = 0;
+        medir_indice<AVL>("AVL     ", claves, consultas, control_avl);
+        medir_indice<ArbolBMas>("Arbol B+", claves, consultas, control_bmas);
+        if (control_avl != control_bmas) {
+            cout << "    [DIFERENCIA EN LOS RESULTADOS]\n";
+        }
+    }
+    return 0;
+}
+
 // ------------------ MAIN -----------------
-int main() {
+int main(int argc, char* argv[]) {
     // Configurar locale del sistema para soportar tildes y caracteres especiales
     setlocale(LC_ALL, "");
     
-    // Instancia principal de la clase Biblioteca (carga los CSVs en el constructor)
-    Biblioteca B;
+    // Opciones de línea de comandos:
+    //   --snapshot            arranca y guarda usando biblioteca.snap (los CSV se exportan al salir)
+    //   --bench-carga [N]     compara el arranque CSV vs instantánea con N libros sintéticos
+    //   --bench-csv [N]       mide el tokenizador CSV (escalar vs SSE2/AVX2) con N libros sintéticos
+    //   --bench-indices [N]   compara el AVL de ISBNs con el árbol B+ (por defecto con 1M y 10M claves)
+    //   --bench-catalogo [N]  compara consultas de recorrido, por género y por fecha sobre el mapa y el catálogo con N libros
+    //   --hilos N             hilos para la carga de los CSV y el grafo (por defecto, uno por núcleo)
+    //   --durabilidad NIVEL   fsync de la bitácora: ninguna | grupo (por defecto) | operacion
+    //   --grupo-ms N          plazo entre fsync en el nivel grupo (por defecto 1000 ms)
+    //   --cola N              capacidad de la cola del hilo escritor (por defecto 4096 registros)
+    //   --cola-llena POLITICA qué hacer con la cola llena: bloquear (por defecto) | rechazar
+    //   --historial-prestamos ID [AAAA-MM]  muestra los préstamos cerrados de un usuario y sale
+    //   --inventario          muestra libros y copias (totales, disponibles, prestadas) por género y sale
+    //   --publicados DESDE HASTA  lista los libros publicados en el rango (AAAA, AAAA-MM o AAAA-MM-DD) y sale
+    //   --recientes N         lista los N libros publicados más recientemente y sale
+    //   --isbn-rango A B      lista en orden los libros con ISBN numérico entre A y B y sale
+    //   --pagina-isbn P [S]   muestra la página P (S libros, 20 por defecto) del listado por ISBN y sale
+    //   --posicion-isbn ISBN [S]  muestra la posición del libro en el listado por ISBN y su página y sale
+    //   --histograma-fechas anio|decada  cuenta los libros publicados por año o por década y sale
+    //   --estadisticas        al salir muestra el tiempo en fsync por archivo y las métricas del escritor
+    bool usar_snapshot = false;
+    NivelDurabilidad durabilidad = DURABILIDAD_GRUPO;
+    long long ms_grupo = 1000;
+    size_t capacidad_cola = 4096;
+    PoliticaColaLlena politica_cola = COLA_LLENA_BLOQUEAR;
+    bool mostrar_estadisticas = false;
+    bool mostrar_inventario = false;
+    string publicados_desde, publicados_hasta;
+    size_t recientes = 0;
+    long long isbn_desde = -1, isbn_hasta = -1;
+    size_t pagina_isbn = 0, tamano_pagina = 20;
+    string isbn_posicion;
+    uint32_t anios_histograma = 0;
+    string historial_usuario, historial_periodo;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--snapshot") {
+            usar_snapshot = true;
+        }
+        else if (arg == "--hilos" && i + 1 < argc) {
+            hilos_carga_configurados = stoul(argv[++i]);
+        }
+        else if (arg == "--durabilidad" && i + 1 < argc) {
+            string nivel = argv[++i];
+            if (nivel == "ninguna") {
+                durabilidad = DURABILIDAD_NINGUNA;
+            }
+            else if (nivel == "operacion") {
+                durabilidad = DURABILIDAD_OPERACION;
+            }
+            else if (nivel == "grupo") {
+                durabilidad = DURABILIDAD_GRUPO;
+            }
+            else {
+                cerr << "Nivel de durabilidad desconocido: " << nivel << " (ninguna | grupo | operacion)" << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--grupo-ms" && i + 1 < argc) {
+            ms_grupo = stoll(argv[++i]);
+        }
+        else if (arg == "--cola" && i + 1 < argc) {
+            capacidad_cola = stoul(argv[++i]);
+        }
+        else if (arg == "--cola-llena" && i + 1 < argc) {
+            string politica = argv[++i];
+            if (politica == "bloquear") {
+                politica_cola = COLA_LLENA_BLOQUEAR;
+            }
+            else if (politica == "rechazar") {
+                politica_cola = COLA_LLENA_RECHAZAR;
+            }
+            else {
+                cerr << "Politica de cola desconocida: " << politica << " (bloquear | rechazar)" << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--historial-prestamos" && i + 1 < argc) {
+            historial_usuario = argv[++i];
+            // Periodo opcional (AAAA-MM)
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                historial_periodo = argv[++i];
+            }
+        }
+        else if (arg == "--estadisticas") {
+            mostrar_estadisticas = true;
+        }
+        else if (arg == "--inventario") {
+            mostrar_inventario = true;
+        }
+        else if (arg == "--publicados" && i + 2 < argc) {
+            publicados_desde = argv[++i];
+            publicados_hasta = argv[++i];
+            if (!limite_fecha(publicados_desde, false) || !limite_fecha(publicados_hasta, true)) {
+                cerr << "Rango de fechas invalido: " << publicados_desde << " " << publicados_hasta
+                     << " (AAAA, AAAA-MM o AAAA-MM-DD)" << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--isbn-rango" && i + 2 < argc) {
+            isbn_desde = stoll(argv[++i]);
+            isbn_hasta = stoll(argv[++i]);
+        }
+        else if ((arg == "--pagina-isbn" || arg == "--posicion-isbn") && i + 1 < argc) {
+            if (arg == "--pagina-isbn") {
+                pagina_isbn = stoul(argv[++i]);
+            }
+            else {
+                isbn_posicion = argv[++i];
+            }
+            // Tamaño de página opcional
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                tamano_pagina = max<size_t>(1, stoul(argv[++i]));
+            }
+        }
+        else if (arg == "--recientes" && i + 1 < argc) {
+            recientes = stoul(argv[++i]);
+        }
+        else if (arg == "--histograma-fechas" && i + 1 < argc) {
+            string periodo = argv[++i];
+            if (periodo == "anio") {
+                anios_histograma = 1;
+            }
+            else if (periodo == "decada") {
+                anios_histograma = 10;
+            }
+            else {
+                cerr << "Periodo desconocido: " << periodo << " (anio | decada)" << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--bench-carga") {
+            size_t n = (i + 1 < argc) ? stoul(argv[i + 1]) : 100000;
+            return benchmark_carga(n);
+        }
+        else if (arg == "--bench-csv") {
+            size_t n = (i + 1 < argc) ? stoul(argv[i + 1]) : 200000;
+            return benchmark_csv(n);
+        }
+        else if (arg == "--bench-indices") {
+            vector<size_t> tamanos = { 1000000, 10000000 };
+            if (i + 1 < argc) {
+                tamanos = { stoul(argv[i + 1]) };
+            }
+            return benchmark_indices(tamanos);
+        }
+        else if (arg == "--bench-catalogo") {
+            size_t n = (i + 1 < argc) ? stoul(argv[i + 1]) : 200000;
+            return benchmark_catalogo(n);
+        }
+    }
+    
+    // Instancia principal de la clase Biblioteca (carga los datos en el constructor)
+    Biblioteca B(usar_snapshot);
+    B.configurarDurabilidad(durabilidad, ms_grupo);
+    B.configurarColaEscritura(capacidad_cola, politica_cola);
+
+    // Consulta del archivo de préstamos sin entrar al menú
+    if (!historial_usuario.empty()) {
+        vector<Prestamo> historial = B.historialPrestamos(historial_usuario, historial_periodo);
+        cout << "--- Prestamos cerrados de " << historial_usuario << " ---" << endl;
+        for (const Prestamo& p : historial) {
+            cout << p.fecha_cierre << "  " << p.id_prestamo << "  " << p.isbn.texto() << "  " << p.titulo << endl;
+        }
+        cout << historial.size() << " prestamos" << endl;
+        return 0;
+    }
+
+    // Inventario por género sin entrar al menú
+    if (mostrar_inventario) {
+        cout << "--- Inventario por genero ---" << endl;
+        cout << B.reporteInventario();
+        return 0;
+    }
+
+    // Reportes de fechas de publicación sin entrar al menú
+    if (!publicados_desde.empty()) {
+        vector<string> encontrados = B.isbnsPublicadosEntre(limite_fecha(publicados_desde, false),
+                                                            limite_fecha(publicados_hasta, true));
+        cout << "--- Publicados entre " << publicados_desde << " y " << publicados_hasta << " ---" << endl;
+        for (const string& isbn : encontrados) {
+            B.mostrar_libro(isbn);
+        }
+        cout << encontrados.size() << " libros" << endl;
+        return 0;
+    }
+    if (isbn_desde >= 0) {
+        B.mostrar_libros_por_isbn_rango(isbn_desde, isbn_hasta);
+        return 0;
+    }
+    if (pagina_isbn > 0) {
+        B.mostrar_pagina_isbn(pagina_isbn, tamano_pagina);
+        return 0;
+    }
+    if (!isbn_posicion.empty()) {
+        size_t posicion = B.posicionIsbn(isbn_posicion);
+        if (posicion == 0) {
+            cout << "El ISBN " << isbn_posicion << " no esta en el listado por ISBN numerico." << endl;
+        }
+        else {
+            cout << "ISBN " << isbn_posicion << ": posicion " << posicion << ", pagina "
+                 << (posicion - 1) / tamano_pagina + 1 << " (de " << tamano_pagina << " libros)" << endl;
+        }
+        return 0;
+    }
+    if (recientes > 0) {
+        cout << "--- " << recientes << " publicados mas recientemente ---" << endl;
+        for (const string& isbn : B.isbnsMasRecientes(recientes)) {
+            B.mostrar_libro(isbn);
+        }
+        return 0;
+    }
+    if (anios_histograma > 0) {
+        cout << "--- Libros publicados por " << (anios_histograma == 1 ? "anio" : "decada") << " ---" << endl;
+        cout << B.reporteFechas(anios_histograma);
+        return 0;
+    }
 
     // Definición del menú de opciones como string constante
     string menu = "\nBienvenido a la Biblioteca Inteligente \n------------------------------------- \n1. Agregar libro \n2. Eliminar libro \n3. Modificar libro \n4. Agregar usuario \n5. Eliminar usuario \n6. Prestar libro \n7. Devolver libro \n8. Buscar titulo (Autocompletar) \n9. Listar libros (Ordenado por título) \n10. Recomendar libros \n11. Ver libro \n12. Ver usuario \n13. Listar libros por ISBN Numerico (AVL) \n14. Deshacer la última acción \n15. Buscar por género \n16. Salir\n";
@@ -2065,8 +7152,14 @@ int main() {
                     cout << ">>> ISBN generado automáticamente: " << nb.isbn << endl;
                 } 
                 else {
-                    // Usa el ISBN proporcionado
+                    // Usa el ISBN proporcionado; un ISBN-10 válido (o un ISBN-13 con guiones)
+                    // se guarda en su forma canónica de 13 dígitos
                     nb.isbn = entrada_isbn;
+                    uint64_t canonico = ClaveIsbn::de(entrada_isbn).canonica();
+                    if (canonico != 0 && to_string(canonico) != entrada_isbn) {
+                        nb.isbn = to_string(canonico);
+                        cout << ">>> ISBN convertido a ISBN-13: " << nb.isbn << endl;
+                    }
                 }
 
                 // --- Lógica para el árbol AVL (Conversión a numérico) ---
@@ -2171,6 +7264,9 @@ int main() {
                 if (B.agregarLibro(nb)) {
                     cout << "Libro agregado y guardado en CSV." << endl;
                 }
+                else if (B.escrituraRechazada()) {
+                    cout << "Cola de escritura llena: la operación no se aplicó, intente de nuevo." << endl;
+                }
                 else {
                     cout << "ISBN ya existe." << endl;
                 }
@@ -2180,11 +7276,15 @@ int main() {
                 string isbn;
                 cout << "ISBN: ";
                 cin >> isbn;
+                isbn = normalizar_isbn(isbn);
                 
                 // Intenta quitar el libro usando la función de la clase
                 if (B.quitarLibros(isbn)) {
                     cout << "Libro removido y CSV actualizado." << endl;
                 }
+                else if (B.escrituraRechazada()) {
+                    cout << "Cola de escritura llena: la operación no se aplicó, intente de nuevo." << endl;
+                }
                 else {
                     cout << "No existe." << endl;
                 }
@@ -2195,6 +7295,7 @@ int main() {
                 string isbn;
                 cout << "ISBN a modificar: ";
                 cin >> isbn;
+                isbn = normalizar_isbn(isbn);
                 // Limpiar buffer
                 cin.ignore();
                 
@@ -2273,6 +7374,9 @@ int main() {
                 if (B.modificarLibro(isbn, nb)) {
                     cout << "Libro modificado y CSV actualizado." << endl;
                 }
+                else if (B.escrituraRechazada()) {
+                    cout << "Cola de escritura llena: la operación no se aplicó, intente de nuevo." << endl;
+                }
                 else{
                     cout << "No se pudo modificar." << endl;
                 }
@@ -2295,6 +7399,9 @@ int main() {
                 if (B.agregarUsuario(nu)) {
                     cout << "Usuario agregado con ID: " << nu.id_usuario << " y guardado en CSV." << endl;
                 }
+                else if (B.escrituraRechazada()) {
+                    cout << "Cola de escritura llena: la operación no se aplicó, intente de nuevo." << endl;
+                }
                 else {
                     cout << "Error: ID generado ya existe (Intente de nuevo)." << endl;
                 }
@@ -2310,6 +7417,9 @@ int main() {
                 if (B.eliminarUsuario(uid)) {
                     cout << "Usuario eliminado y CSV actualizado." << endl;
                 }
+                else if (B.escrituraRechazada()) {
+                    cout << "Cola de escritura llena: la operación no se aplicó, intente de nuevo." << endl;
+                }
                 else {
                     cout << "No existe ese usuario." << endl;
                 }
@@ -2322,6 +7432,7 @@ int main() {
                 cin >> uid;
                 cout << "ISBN: ";
                 cin >> isbn;
+                isbn = normalizar_isbn(isbn);
                 
                 // Llama a prestamoLibro y recoge el código de resultado
                 int resultado = B.prestamoLibro(uid, isbn);
@@ -2339,6 +7450,9 @@ int main() {
                 else if (resultado == -1) {
                     cout << "Error: El Usuario ingresado no existe." << endl;
                 }
+                else if (resultado == -2) {
+                    cout << "Cola de escritura llena: el préstamo no se aplicó, intente de nuevo." << endl;
+                }
             } break;
 
             // CASO 7: DEVOLVER LIBRO
@@ -2348,11 +7462,15 @@ int main() {
                 cin >> uid;
                 cout << "ISBN: ";
                 cin >> isbn;
+                isbn = normalizar_isbn(isbn);
                 
                 // Intenta devolver
                 if (B.devolver_libro(uid, isbn)) {
                     cout << "Devolucion procesada. CSVs actualizados." << endl;
                 }
+                else if (B.escrituraRechazada()) {
+                    cout << "Cola de escritura llena: la operación no se aplicó, intente de nuevo." << endl;
+                }
                 else {
                     cout << "Error al devolver. Verifique ID/ISBN." << endl;
                 }
@@ -2422,6 +7540,7 @@ int main() {
                 string isbn;
                 cout << "ISBN: ";
                 cin >> isbn;
+                isbn = normalizar_isbn(isbn);
                 B.mostrar_libro(isbn);
             } break;
 
@@ -2459,5 +7578,11 @@ int main() {
     }
     // Fin del programa
     cout << "Saliendo..." << endl;
+    // Deja todo en disco antes de mostrar las estadísticas
+    if (mostrar_estadisticas) {
+        B.finalizar();
+        cout << "Tiempo en fsync por archivo:\n" << B.reporteSincronizacion();
+        cout << "Hilo escritor de la bitacora:\n" << B.reporteEscritor();
+    }
     return 0;
 }
\ No newline at end of file